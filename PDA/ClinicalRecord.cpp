@@ -3,25 +3,77 @@
 namespace cge{
    namespace patients{
 
+//A view of row row of T. Writes go to T.
+ClinicalRecord::ClinicalRecord(std::shared_ptr<ClinicalTable> T, size_t row) :
+   clinical_schema(T->schema()), table(T), table_row(row)
+{
+   if (row >= T->patientCount())
+      throw std::out_of_range("This row doesn't exist in the table");
+}
+
+//Copies the values out of the table into this record's own storage.
+void ClinicalRecord::detachFromTable()
+{
+   std::shared_ptr<ClinicalTable> T = table;
+   table.reset();
+   values.assign(T->fieldCount(), CompactValue());
+   boxed_values.assign(T->fieldCount(), nullptr);
+   for (size_t f = 0; f < T->fieldCount(); ++f){
+      CompactValue v = T->value(f, table_row);
+      if (v.typeTag() == ClinicalType::String){
+         boxed_values[f].reset(new StringValue(v.asString()));
+         values[f] = CompactValue(boxed_values[f].get());
+      }
+      else if (v.typeTag() == ClinicalType::History){
+         boxed_values[f] = T->column(f).sharedHistory(table_row);
+         values[f] = CompactValue(boxed_values[f].get());
+      }
+      else
+         values[f] = v;
+   }
+}
+
 std::shared_ptr<ClinicalSchema> ClinicalRecord::schema() const
 {
    return clinical_schema;
 }
 
+//Giving a table view a different schema turns it into a record of its own.
 void ClinicalRecord::setSchema(std::shared_ptr<ClinicalSchema> S)
 {
+   if (table && S != table->schema())
+      detachFromTable();
    clinical_schema = S;
 }
 
-void ClinicalRecord::setClinicalValue(size_t pos, ClinicalValue* v)
+void ClinicalRecord::checkPosition(size_t pos)
 {
    //checks if pos represents a valid position on the schema
    if (pos >= (this->schema()->size()))
       throw std::out_of_range("This position doesn't exist in the schema");
-   if (pos >= values.size())
+   if (!table && pos >= values.size()){
       values.resize(this->schema()->size());
-   std::shared_ptr<ClinicalValue> share_v(v);
-   values.at(pos) = share_v;
+      boxed_values.resize(this->schema()->size());
+   }
+}
+
+void ClinicalRecord::setClinicalValue(size_t pos, ClinicalValue* v)
+{
+   std::unique_ptr<ClinicalValue> owned;
+   //the missing value is a singleton, never owned
+   if (v->typeTag() != ClinicalType::Missing)
+      owned.reset(v);
+   checkPosition(pos);
+   if (table){
+      owned.release();   //the table takes ownership
+      table->setValue(pos, table_row, v);
+      return;
+   }
+   values.at(pos) = CompactValue(v);
+   if (values.at(pos).isBoxed())
+      boxed_values.at(pos).reset(owned.release());
+   else
+      boxed_values.at(pos).reset();
 }
 
 void ClinicalRecord::setClinicalValue(const std::string& name, ClinicalValue* v)
@@ -29,51 +81,71 @@ void ClinicalRecord::setClinicalValue(const std::string& name, ClinicalValue* v)
    this->setClinicalValue(this->schema()->indexOfField(name), v); 
 }
 
-const ClinicalValue* ClinicalRecord::value(size_t pos) const
+void ClinicalRecord::setClinicalValue(size_t pos, CompactValue v)
 {
-   if(pos >= values.size())
-      throw std::out_of_range("This is not a valid position.");
-   return (values.at(pos).get());
+   if (v.isBoxed())
+      throw std::invalid_argument("String and History values must be set "
+            "as a ClinicalValue");
+   checkPosition(pos);
+   if (table){
+      table->setValue(pos, table_row, v);
+      return;
+   }
+   values.at(pos) = v;
+   boxed_values.at(pos).reset();
 }
 
-const ClinicalValue* ClinicalRecord::value(const std::string & name) const
+void ClinicalRecord::setClinicalValue(const std::string& name, CompactValue v)
 {
-   return this->value(this->schema()->indexOfField(name));
+   this->setClinicalValue(this->schema()->indexOfField(name), v); 
 }
 
-std::shared_ptr<ClinicalValue>& ClinicalRecord::operator[](size_t i)
+CompactValue ClinicalRecord::value(size_t pos) const
 {
-   if(i >= values.size())
-      throw std::out_of_range("Index out of bounds");
-   return (this->values.at(i));
+   if (table && pos < table->fieldCount())
+      return table->value(pos, table_row);
+   if (table || pos >= values.size()){
+      if (clinical_schema && pos < clinical_schema->size())
+         return CompactValue();
+      throw std::out_of_range("This is not a valid position.");
+   }
+   return values[pos];
+}
+
+CompactValue ClinicalRecord::value(const std::string & name) const
+{
+   return this->value(this->schema()->indexOfField(name));
 }
 
-const std::shared_ptr<ClinicalValue> ClinicalRecord::operator[](size_t i) const
+CompactValue ClinicalRecord::operator[](size_t i) const
 {
-   if(i >= values.size())
-      throw std::out_of_range("Index out of bounds");
-   return (this->values.at(i));
+   return this->value(i);
 }
 
-std::shared_ptr<ClinicalValue>& ClinicalRecord::operator[]
-   (const std::string& name)
+CompactValue ClinicalRecord::operator[](const std::string& name) const
 {
-   return (this->values.at(this->schema()->indexOfField(name)));
+   return this->value(name);
 }
 
-const std::shared_ptr<ClinicalValue> ClinicalRecord::operator[]
-   (const std::string& name) const
+const std::vector<CompactValue> ClinicalRecord::valuesAsVector() const
 {
-   return (this->values.at(this->schema()->indexOfField(name)));
+   if (!table)
+      return values;
+   std::vector<CompactValue> row_values;
+   row_values.reserve(table->fieldCount());
+   for (size_t f = 0; f < table->fieldCount(); ++f)
+      row_values.push_back(table->value(f, table_row));
+   return row_values;
 }
 
-const std::vector<std::shared_ptr<const ClinicalValue>> 
-      ClinicalRecord::valuesAsVector() const
+std::shared_ptr<const ClinicalValue> 
+   ClinicalRecord::sharedHistory(size_t pos) const
 {
-   std::vector<std::shared_ptr<const ClinicalValue>> value_vector;
-   for (size_t i = 0; i < values.size(); ++i)
-      value_vector.push_back(values.at(i)); //makes each CV constant
-   return value_vector;
+   if (table)
+      return table->column(pos).sharedHistory(table_row);
+   if (pos >= values.size() || values[pos].typeTag() != ClinicalType::History)
+      return nullptr;
+   return boxed_values[pos];
 }
 
 }//namespace patients
@@ -3,6 +3,7 @@
 
 #include "ClinicalSchema.h"
 #include "ClinicalValue.h"
+#include "ClinicalTable.h"
 
 namespace cge{
    namespace patients{
@@ -11,24 +12,42 @@ class ClinicalRecord
 {
 private: 
    std::shared_ptr<ClinicalSchema> clinical_schema;
-   std::vector<std::shared_ptr<ClinicalValue>> values;
+   //one value per schema field, held contiguously
+   std::vector<CompactValue> values;
+   //the strings and histories that values refer to, at the same positions
+   std::vector<std::shared_ptr<const ClinicalValue>> boxed_values;
+   //when set, the values are row table_row of a cohort table
+   std::shared_ptr<ClinicalTable> table;
+   size_t table_row;
+   void checkPosition(size_t pos);
+   void detachFromTable();
 public:
-   ClinicalRecord()
+   ClinicalRecord() : table_row(0)
    {
       values.reserve(1);
    }
+   ClinicalRecord(std::shared_ptr<ClinicalTable> T, size_t row);
    std::shared_ptr<ClinicalSchema> schema() const;
    void setSchema(std::shared_ptr<ClinicalSchema> S);
+   //Takes ownership of v. Int, Double, Bool and Date values are copied into
+   //the record and v is deleted.
    void setClinicalValue(size_t pos, ClinicalValue* v);
    void setClinicalValue(const std::string& name, ClinicalValue* v);
-   const ClinicalValue* value(size_t pos) const;
-   const ClinicalValue* value(const std::string & name) const;
-   std::shared_ptr<ClinicalValue>& operator[](size_t i);
-   const std::shared_ptr<ClinicalValue> operator[](size_t i) const;
-   std::shared_ptr<ClinicalValue>& operator[](const std::string& name);
-   const std::shared_ptr<ClinicalValue> operator[](const std::string& name) const;
-   const std::vector<std::shared_ptr<const ClinicalValue>> 
-      valuesAsVector() const;
+   //v must not be a String or History value, which have to be passed as
+   //ClinicalValue.
+   void setClinicalValue(size_t pos, CompactValue v);
+   void setClinicalValue(const std::string& name, CompactValue v);
+   //Unset values are missing.
+   CompactValue value(size_t pos) const;
+   CompactValue value(const std::string & name) const;
+   CompactValue operator[](size_t i) const;
+   CompactValue operator[](const std::string& name) const;
+   const std::vector<CompactValue> valuesAsVector() const;
+   //The History value at pos, shared, or nullptr if it holds none.
+   std::shared_ptr<const ClinicalValue> sharedHistory(size_t pos) const;
+   bool isTableView() const {return table.get() != nullptr;}
+   std::shared_ptr<ClinicalTable> clinicalTable() const {return table;}
+   size_t tableRow() const {return table_row;}
 };
 
 }//namespace patients
@@ -0,0 +1,585 @@
+#include "ClinicalTable.h"
+#include <bitset>
+#include <algorithm>
+#include <functional>
+
+namespace cge{
+   namespace patients{
+
+namespace{
+
+size_t wordsFor(size_t bits)
+{
+   return (bits + 63) / 64;
+}
+
+void setBit(std::vector<uint64_t>& words, size_t i, bool b)
+{
+   uint64_t mask = (uint64_t)1 << (i % 64);
+   if (b)
+      words[i / 64] |= mask;
+   else
+      words[i / 64] &= ~mask;
+}
+
+//Sets bit i of out if op(values[i], c), a word at a time with no branches
+//on the data.
+template <typename T, typename U, typename Op>
+void compareWords(const T* values, size_t n, U c, Op op, uint64_t* out)
+{
+   for (size_t first = 0; first < n; first += 64){
+      size_t count = std::min<size_t>(64, n - first);
+      uint64_t bits = 0;
+      for (size_t k = 0; k < count; ++k)
+         bits |= (uint64_t)op(values[first + k], c) << k;
+      out[first / 64] = bits;
+   }
+}
+
+template <typename T, typename U>
+void compareColumn(const T* values, size_t n, CompareOp op, U c, 
+      uint64_t* out)
+{
+   switch (op){
+      case CompareOp::Equal:
+         compareWords(values, n, c, std::equal_to<U>(), out);
+         break;
+      case CompareOp::NotEqual:
+         compareWords(values, n, c, std::not_equal_to<U>(), out);
+         break;
+      case CompareOp::Less:
+         compareWords(values, n, c, std::less<U>(), out);
+         break;
+      case CompareOp::LessEqual:
+         compareWords(values, n, c, std::less_equal<U>(), out);
+         break;
+      case CompareOp::Greater:
+         compareWords(values, n, c, std::greater<U>(), out);
+         break;
+      default:
+         compareWords(values, n, c, std::greater_equal<U>(), out);
+   }
+}
+
+}
+
+ClinicalColumn::ClinicalColumn(size_t rows) : 
+   column_type(ClinicalType::Missing), n_rows(0)
+{
+   resize(rows);
+}
+
+//Gives the column storage for type t, or checks that it already has it.
+void ClinicalColumn::setType(ClinicalType t)
+{
+   if (column_type == t)
+      return;
+   if (column_type != ClinicalType::Missing)
+      throw std::invalid_argument(std::string("Field holds ") + 
+            typeName(column_type) + " values, not " + typeName(t));
+   column_type = t;
+   resize(n_rows);
+}
+
+void ClinicalColumn::resize(size_t rows)
+{
+   if (column_index)
+      column_index->invalidate();
+   n_rows = rows;
+   validity.resize(wordsFor(rows), 0);
+   switch (column_type){
+      case ClinicalType::Int:
+      case ClinicalType::Date:
+         int_values.resize(rows, 0);
+         break;
+      case ClinicalType::Double:
+         double_values.resize(rows, 0);
+         break;
+      case ClinicalType::Bool:
+         bool_values.resize(wordsFor(rows), 0);
+         break;
+      case ClinicalType::String:
+         string_codes.resize(rows, 0);
+         break;
+      case ClinicalType::History:
+         history_values.resize(rows);
+         break;
+      default:
+         break;
+   }
+}
+
+uint32_t ClinicalColumn::intern(const std::string& s)
+{
+   auto found = dictionary_index.find(s);
+   if (found != dictionary_index.end())
+      return found->second;
+   uint32_t code = dictionary.size();
+   dictionary.push_back(std::unique_ptr<StringValue>(new StringValue(s)));
+   dictionary_index[s] = code;
+   return code;
+}
+
+uint32_t ClinicalColumn::dictionaryCode(const std::string& s) const
+{
+   auto found = dictionary_index.find(s);
+   if (found == dictionary_index.end())
+      return dictionary.size();
+   return found->second;
+}
+
+void ClinicalColumn::checkRow(size_t row) const
+{
+   if (row >= n_rows)
+      throw std::out_of_range("This is not a valid position.");
+}
+
+void ClinicalColumn::set(size_t row, CompactValue v)
+{
+   checkRow(row);
+   if (v.isMissing()){
+      setMissing(row);
+      return;
+   }
+   if (column_index)
+      column_index->invalidate();
+   if (v.typeTag() == ClinicalType::History)
+      throw std::invalid_argument("History values must be set by pointer");
+   setType(v.typeTag());
+   switch (column_type){
+      case ClinicalType::Int:
+         int_values[row] = v.asInt();
+         break;
+      case ClinicalType::Date:
+         int_values[row] = v.days();
+         break;
+      case ClinicalType::Double:
+         double_values[row] = v.asDouble();
+         break;
+      case ClinicalType::Bool:
+         setBit(bool_values, row, v.asBool());
+         break;
+      case ClinicalType::String:
+         string_codes[row] = intern(v.asString());
+         break;
+      default:
+         break;
+   }
+   setBit(validity, row, true);
+}
+
+void ClinicalColumn::setHistory(size_t row, 
+      std::shared_ptr<const ClinicalValue> h)
+{
+   checkRow(row);
+   setType(ClinicalType::History);
+   if (column_index)
+      column_index->invalidate();
+   history_values[row] = h;
+   setBit(validity, row, true);
+}
+
+void ClinicalColumn::setMissing(size_t row)
+{
+   checkRow(row);
+   if (column_index)
+      column_index->invalidate();
+   setBit(validity, row, false);
+   if (column_type == ClinicalType::History)
+      history_values[row].reset();
+}
+
+CompactValue ClinicalColumn::value(size_t row) const
+{
+   checkRow(row);
+   if (!isValid(row))
+      return CompactValue();
+   switch (column_type){
+      case ClinicalType::Int:
+         return CompactValue(int_values[row]);
+      case ClinicalType::Date:
+         return CompactValue::fromDays(int_values[row]);
+      case ClinicalType::Double:
+         return CompactValue(double_values[row]);
+      case ClinicalType::Bool:
+         return CompactValue(bit(bool_values, row));
+      case ClinicalType::String:
+         return CompactValue(dictionary[string_codes[row]].get());
+      case ClinicalType::History:
+         return CompactValue(history_values[row].get());
+      default:
+         return CompactValue();
+   }
+}
+
+size_t ClinicalColumn::validCount() const
+{
+   size_t total = 0;
+   for (auto w = validity.begin(); w != validity.end(); ++w)
+      total += std::bitset<64>(*w).count();
+   return total;
+}
+
+void ClinicalColumn::dateRange(date::Days first, date::Days last, 
+      std::vector<uint64_t>& out) const
+{
+   if (column_type == ClinicalType::Missing){
+      out.assign(validity.size(), 0);
+      return;
+   }
+   if (column_type != ClinicalType::Date)
+      throw std::invalid_argument("Field does not hold dates");
+   out.resize(validity.size());
+   date::inRange(int_values.data(), n_rows, first, last, out.data());
+   for (size_t w = 0; w < out.size(); ++w)
+      out[w] &= validity[w];
+}
+
+void ClinicalColumn::compare(CompareOp op, const CompactValue& v, 
+      std::vector<uint64_t>& out) const
+{
+   out.assign(validity.size(), 0);
+   if (column_type == ClinicalType::Missing || v.isMissing())
+      return;
+   ClinicalType t = v.typeTag();
+   bool number = (t == ClinicalType::Int || t == ClinicalType::Double);
+   if (column_type == ClinicalType::Int && t == ClinicalType::Int)
+      compareColumn(int_values.data(), n_rows, op, (int32_t)v.asInt(), 
+            out.data());
+   else if (column_type == ClinicalType::Int && number)
+      compareColumn(int_values.data(), n_rows, op, v.asDouble(), out.data());
+   else if (column_type == ClinicalType::Double && number)
+      compareColumn(double_values.data(), n_rows, op, 
+            (t == ClinicalType::Int) ? (double)v.asInt() : v.asDouble(), 
+            out.data());
+   else if (column_type == ClinicalType::Date && t == ClinicalType::Date)
+      compareColumn(int_values.data(), n_rows, op, v.days(), out.data());
+   else if (column_type == ClinicalType::Bool && t == ClinicalType::Bool){
+      //every row is true or false, so the result is one, the other or both
+      uint64_t if_true = compareValues(CompactValue(true), op, v) ? ~0ULL : 0;
+      uint64_t if_false = compareValues(CompactValue(false), op, v) ? ~0ULL:0;
+      for (size_t w = 0; w < out.size(); ++w)
+         out[w] = (bool_values[w] & if_true) | (~bool_values[w] & if_false);
+   }
+   else if (column_type == ClinicalType::String && t == ClinicalType::String){
+      //compares each distinct string once, then maps the rows' codes
+      std::vector<uint8_t> match(dictionary.size());
+      for (size_t c = 0; c < dictionary.size(); ++c)
+         match[c] = compareValues(CompactValue(dictionary[c].get()), op, v);
+      for (size_t first = 0; first < n_rows; first += 64){
+         size_t count = std::min<size_t>(64, n_rows - first);
+         uint64_t bits = 0;
+         for (size_t k = 0; k < count; ++k)
+            bits |= (uint64_t)match[string_codes[first + k]] << k;
+         out[first / 64] = bits;
+      }
+   }
+   else
+      throw std::invalid_argument(std::string("Cannot compare ") + 
+            typeName(column_type) + " with " + typeName(t));
+   for (size_t w = 0; w < out.size(); ++w)
+      out[w] &= validity[w];
+}
+
+void ClinicalColumn::createIndex()
+{
+   if (!column_index)
+      column_index.reset(new ColumnIndex());
+}
+
+void ClinicalColumn::dropIndex()
+{
+   column_index.reset();
+}
+
+const char* indexKindName(IndexKind k)
+{
+   switch (k){
+      case IndexKind::Sorted: return "Sorted";
+      case IndexKind::Bitmap: return "Bitmap";
+      default: return "None";
+   }
+}
+
+//Called with lock held.
+void ColumnIndex::rebuild(const ClinicalColumn& c) const
+{
+   stale = false;
+   index_kind = IndexKind::None;
+   keys.clear();
+   rows.clear();
+   bitmaps.clear();
+   const std::vector<uint64_t>& valid = c.validity;
+   switch (c.column_type){
+      case ClinicalType::Int:
+      case ClinicalType::Date:
+      case ClinicalType::Double:
+      {
+         bool doubles = (c.column_type == ClinicalType::Double);
+         std::vector<std::pair<double, uint32_t>> entries;
+         entries.reserve(c.validCount());
+         for (size_t r = 0; r < c.n_rows; ++r){
+            if (ClinicalColumn::bit(valid, r))
+               entries.push_back(std::make_pair(doubles ? 
+                        c.double_values[r] : c.int_values[r], (uint32_t)r));
+         }
+         std::sort(entries.begin(), entries.end());
+         keys.resize(entries.size());
+         rows.resize(entries.size());
+         for (size_t k = 0; k < entries.size(); ++k){
+            keys[k] = entries[k].first;
+            rows[k] = entries[k].second;
+         }
+         index_kind = IndexKind::Sorted;
+         break;
+      }
+      case ClinicalType::Bool:
+         bitmaps.assign(2, std::vector<uint64_t>(valid.size()));
+         for (size_t w = 0; w < valid.size(); ++w){
+            bitmaps[0][w] = valid[w] & ~c.bool_values[w];
+            bitmaps[1][w] = valid[w] & c.bool_values[w];
+         }
+         index_kind = IndexKind::Bitmap;
+         break;
+      case ClinicalType::String:
+         if (c.dictionary.size() > MaxBitmapValues)
+            break;
+         bitmaps.assign(c.dictionary.size(), 
+               std::vector<uint64_t>(valid.size(), 0));
+         for (size_t r = 0; r < c.n_rows; ++r){
+            if (ClinicalColumn::bit(valid, r))
+               setBit(bitmaps[c.string_codes[r]], r, true);
+         }
+         index_kind = IndexKind::Bitmap;
+         break;
+      default:
+         break;
+   }
+}
+
+void ColumnIndex::setRows(size_t first, size_t last, 
+      std::vector<uint64_t>& out) const
+{
+   for (size_t k = first; k < last; ++k)
+      out[rows[k] / 64] |= (uint64_t)1 << (rows[k] % 64);
+}
+
+IndexKind ColumnIndex::kind(const ClinicalColumn& c) const
+{
+   std::lock_guard<std::mutex> guard(lock);
+   if (stale)
+      rebuild(c);
+   return index_kind;
+}
+
+IndexKind ColumnIndex::compare(const ClinicalColumn& c, CompareOp op, 
+      const CompactValue& v, std::vector<uint64_t>& out) const
+{
+   std::lock_guard<std::mutex> guard(lock);
+   if (stale)
+      rebuild(c);
+   ClinicalType t = v.typeTag();
+   if (index_kind == IndexKind::Sorted){
+      bool number = (t == ClinicalType::Int || t == ClinicalType::Double);
+      if ((c.column_type == ClinicalType::Date) != (t == ClinicalType::Date) 
+            || (t != ClinicalType::Date && !number))
+         return IndexKind::None;
+      double key = (t == ClinicalType::Int) ? v.asInt() : 
+         (t == ClinicalType::Double) ? v.asDouble() : v.days();
+      size_t lo = std::lower_bound(keys.begin(), keys.end(), key) - 
+         keys.begin();
+      size_t hi = std::upper_bound(keys.begin(), keys.end(), key) - 
+         keys.begin();
+      //the matching stretches of keys
+      size_t first[2] = {0, 0};
+      size_t last[2] = {0, 0};
+      switch (op){
+         case CompareOp::Equal: first[0] = lo; last[0] = hi; break;
+         case CompareOp::NotEqual: 
+            last[0] = lo; first[1] = hi; last[1] = keys.size(); 
+            break;
+         case CompareOp::Less: last[0] = lo; break;
+         case CompareOp::LessEqual: last[0] = hi; break;
+         case CompareOp::Greater: first[0] = hi; last[0] = keys.size(); break;
+         default: first[0] = lo; last[0] = keys.size();
+      }
+      //setting many scattered bits is slower than the column scan
+      if ((last[0] - first[0]) + (last[1] - first[1]) > c.n_rows / 8)
+         return IndexKind::None;
+      out.assign(c.validity.size(), 0);
+      setRows(first[0], last[0], out);
+      setRows(first[1], last[1], out);
+      return IndexKind::Sorted;
+   }
+   if (index_kind == IndexKind::Bitmap){
+      if (t != c.column_type)
+         return IndexKind::None;
+      std::vector<size_t> codes;
+      for (size_t k = 0; k < bitmaps.size(); ++k){
+         CompactValue value = (t == ClinicalType::Bool) ? 
+            CompactValue(k == 1) : CompactValue(c.dictionary[k].get());
+         if (compareValues(value, op, v))
+            codes.push_back(k);
+      }
+      //reading more bitmaps than this is slower than the column scan
+      if (codes.size() > 32)
+         return IndexKind::None;
+      out.assign(c.validity.size(), 0);
+      for (auto k = codes.begin(); k != codes.end(); ++k){
+         for (size_t w = 0; w < out.size(); ++w)
+            out[w] |= bitmaps[*k][w];
+      }
+      return IndexKind::Bitmap;
+   }
+   return IndexKind::None;
+}
+
+IndexKind ColumnIndex::dateRange(const ClinicalColumn& c, date::Days first, 
+      date::Days last, std::vector<uint64_t>& out) const
+{
+   std::lock_guard<std::mutex> guard(lock);
+   if (stale)
+      rebuild(c);
+   if (index_kind != IndexKind::Sorted || c.column_type != ClinicalType::Date)
+      return IndexKind::None;
+   size_t lo = std::lower_bound(keys.begin(), keys.end(), (double)first) - 
+      keys.begin();
+   size_t hi = std::upper_bound(keys.begin(), keys.end(), (double)last) - 
+      keys.begin();
+   hi = std::max(lo, hi);
+   if (hi - lo > c.n_rows / 8)
+      return IndexKind::None;
+   out.assign(c.validity.size(), 0);
+   setRows(lo, hi, out);
+   return IndexKind::Sorted;
+}
+
+ClinicalTable::ClinicalTable(std::shared_ptr<ClinicalSchema> S, 
+      size_t patients) : 
+   table_schema(S), n_patients(patients)
+{
+   growToSchema();
+}
+
+void ClinicalTable::checkPosition(size_t f, size_t p) const
+{
+   if (f >= columns.size() || p >= n_patients)
+      throw std::out_of_range("This is not a valid position.");
+}
+
+std::shared_ptr<ClinicalSchema> ClinicalTable::schema() const
+{
+   return table_schema;
+}
+
+size_t ClinicalTable::patientCount() const
+{
+   return n_patients;
+}
+
+size_t ClinicalTable::fieldCount() const
+{
+   return columns.size();
+}
+
+//Adds empty columns for fields appended to the schema since the last call.
+void ClinicalTable::growToSchema()
+{
+   while (columns.size() < table_schema->size())
+      columns.push_back(std::unique_ptr<ClinicalColumn>(
+               new ClinicalColumn(n_patients)));
+}
+
+const ClinicalColumn& ClinicalTable::column(size_t f) const
+{
+   if (f >= columns.size())
+      throw std::out_of_range("This is not a valid position.");
+   return *columns[f];
+}
+
+const ClinicalColumn& ClinicalTable::column(const std::string& name) const
+{
+   return column(table_schema->indexOfField(name));
+}
+
+CompactValue ClinicalTable::value(size_t f, size_t p) const
+{
+   checkPosition(f, p);
+   return columns[f]->value(p);
+}
+
+void ClinicalTable::setValue(size_t f, size_t p, ClinicalValue* v)
+{
+   std::unique_ptr<ClinicalValue> owned;
+   //the missing value is a singleton, never owned
+   if (v->typeTag() != ClinicalType::Missing)
+      owned.reset(v);
+   if (f >= columns.size())
+      growToSchema();
+   checkPosition(f, p);
+   if (v->typeTag() == ClinicalType::History)
+      columns[f]->setHistory(p, 
+            std::shared_ptr<const ClinicalValue>(owned.release()));
+   else
+      columns[f]->set(p, CompactValue(v));
+}
+
+void ClinicalTable::setValue(size_t f, size_t p, CompactValue v)
+{
+   if (f >= columns.size())
+      growToSchema();
+   checkPosition(f, p);
+   columns[f]->set(p, v);
+}
+
+void ClinicalTable::setHistory(size_t f, size_t p, 
+      std::shared_ptr<const ClinicalValue> h)
+{
+   if (f >= columns.size())
+      growToSchema();
+   checkPosition(f, p);
+   if (!h || h->typeTag() != ClinicalType::History)
+      throw std::invalid_argument("Value is not a History value");
+   columns[f]->setHistory(p, h);
+}
+
+void ClinicalTable::setMissing(size_t f, size_t p)
+{
+   checkPosition(f, p);
+   columns[f]->setMissing(p);
+}
+
+void ClinicalTable::createIndex(size_t f)
+{
+   if (f >= columns.size())
+      growToSchema();
+   if (f >= columns.size())
+      throw std::out_of_range("This is not a valid position.");
+   columns[f]->createIndex();
+}
+
+void ClinicalTable::dropIndex(size_t f)
+{
+   if (f < columns.size())
+      columns[f]->dropIndex();
+}
+
+//Mean of the values of an Int or Double field, skipping missing ones. 0 if
+//there are none.
+double ClinicalTable::mean(size_t f) const
+{
+   const ClinicalColumn& c = column(f);
+   if (c.type() != ClinicalType::Int && c.type() != ClinicalType::Double)
+      throw std::invalid_argument("Field is not numeric");
+   double sum = 0;
+   for (size_t row = 0; row < c.n_rows; ++row){
+      if (c.isValid(row))
+         sum += (c.type() == ClinicalType::Int) ? c.int_values[row] : 
+            c.double_values[row];
+   }
+   size_t n = c.validCount();
+   return (n == 0) ? 0 : sum / n;
+}
+
+}//namespace patients
+}//namespace cge
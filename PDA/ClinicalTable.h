@@ -0,0 +1,184 @@
+#ifndef CLINICALTABLE_H
+#define CLINICALTABLE_H
+
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <mutex>
+#include "ClinicalSchema.h"
+#include "ClinicalValue.h"
+
+namespace cge{
+   namespace patients{
+
+class ClinicalColumn;
+
+enum class IndexKind : uint8_t
+{
+   None, Sorted, Bitmap
+};
+
+const char* indexKindName(IndexKind k);
+
+//An index over a ClinicalColumn: the valid rows sorted by value for Int,
+//Double and Date columns, and a bitmap of rows per value for Bool columns
+//and String columns with at most MaxBitmapValues distinct strings. The 
+//column marks it stale on every write and it is rebuilt on the next lookup,
+//so it never answers from old values. Lookups may run concurrently; writes
+//to the column must not overlap them.
+class ColumnIndex
+{
+private:
+   mutable std::mutex lock;
+   mutable bool stale;
+   mutable IndexKind index_kind;
+   //sorted index: keys[k] is the value of row rows[k]
+   mutable std::vector<double> keys;
+   mutable std::vector<uint32_t> rows;
+   //bitmap index: the rows holding false and true, or each string code
+   mutable std::vector<std::vector<uint64_t>> bitmaps;
+   ColumnIndex(const ColumnIndex&);              //Prevent copy-construction
+   ColumnIndex& operator=(const ColumnIndex&);   //Prevent assignment
+   void rebuild(const ClinicalColumn& c) const;
+   void setRows(size_t first, size_t last, std::vector<uint64_t>& out) const;
+public:
+   static const size_t MaxBitmapValues = 256;
+
+   ColumnIndex() : stale(true), index_kind(IndexKind::None) { }
+   void invalidate() {stale = true;}
+   //The kind of index c currently has; None if its type has none.
+   IndexKind kind(const ClinicalColumn& c) const;
+   //As ClinicalColumn::compare. Returns the index used, or None, leaving 
+   //out alone, if there is none for c and v or a scan would be quicker.
+   IndexKind compare(const ClinicalColumn& c, CompareOp op, 
+         const CompactValue& v, std::vector<uint64_t>& out) const;
+   //As ClinicalColumn::dateRange, and returns as compare does.
+   IndexKind dateRange(const ClinicalColumn& c, date::Days first, 
+         date::Days last, std::vector<uint64_t>& out) const;
+};
+
+//The values of one clinical field across a cohort, one row per patient, in 
+//contiguous storage for the field's type: int32 for Int, days since 1970 
+//for Date, double for Double, a bitmap for Bool and dictionary codes for
+//String. Histories are held by pointer. A validity 
+//bitmap marks the rows that have a value; the others are missing. The type 
+//is fixed by the first value set.
+class ClinicalColumn
+{
+   friend class ClinicalTable;
+   friend class ColumnIndex;
+private:
+   ClinicalType column_type;
+   size_t n_rows;
+   std::vector<uint64_t> validity;
+   std::vector<int32_t> int_values;   //Int, and Date as date::Days
+   std::vector<double> double_values;
+   std::vector<uint64_t> bool_values;
+   std::vector<uint32_t> string_codes;
+   //distinct strings, in order of first use; the StringValues give 
+   //CompactValues something to refer to
+   std::vector<std::unique_ptr<StringValue>> dictionary;
+   std::unordered_map<std::string, uint32_t> dictionary_index;
+   std::vector<std::shared_ptr<const ClinicalValue>> history_values;
+   std::unique_ptr<ColumnIndex> column_index;
+
+   void checkRow(size_t row) const;
+   void setType(ClinicalType t);
+   void resize(size_t rows);
+   uint32_t intern(const std::string& s);
+   void setHistory(size_t row, std::shared_ptr<const ClinicalValue> h);
+public:
+   //rows missing values
+   ClinicalColumn(size_t rows);
+   //Strings v refers to are copied into the dictionary; v must not be a 
+   //History value. Throws std::invalid_argument if v's type differs from
+   //the column's. Both throw std::out_of_range if there is no such row.
+   void set(size_t row, CompactValue v);
+   void setMissing(size_t row);
+
+   static bool bit(const std::vector<uint64_t>& words, size_t i)
+   {
+      return (words[i / 64] >> (i % 64)) & 1;
+   }
+
+   //Missing until a value is set.
+   ClinicalType type() const {return column_type;}
+   size_t size() const {return n_rows;}
+   bool isValid(size_t row) const {return bit(validity, row);}
+   CompactValue value(size_t row) const;
+
+   //Bit row of validity() is set if row has a value.
+   const std::vector<uint64_t>& validityBitmap() const {return validity;}
+   //Storage of the column's type, one entry per row, empty for other types.
+   const std::vector<int32_t>& ints() const {return int_values;}
+   const std::vector<double>& doubles() const {return double_values;}
+   const std::vector<uint64_t>& boolBitmap() const {return bool_values;}
+   const std::vector<uint32_t>& stringCodes() const {return string_codes;}
+   //The string with dictionary code c.
+   const std::string& dictionaryString(uint32_t c) const
+   {
+      return dictionary.at(c)->str();
+   }
+   size_t dictionarySize() const {return dictionary.size();}
+   //Code of s, or dictionarySize() if no row holds s.
+   uint32_t dictionaryCode(const std::string& s) const;
+   size_t validCount() const;
+   //Sets bit row of out if row holds a date from first to last, inclusive.
+   void dateRange(date::Days first, date::Days last, 
+         std::vector<uint64_t>& out) const;
+   //Sets bit row of out if row holds a value v with value op v, compared as
+   //compareValues does; missing rows never match. Throws 
+   //std::invalid_argument if v cannot be compared with the column's type.
+   void compare(CompareOp op, const CompactValue& v, 
+         std::vector<uint64_t>& out) const;
+   void createIndex();
+   void dropIndex();
+   //The column's index, or nullptr.
+   const ColumnIndex* index() const {return column_index.get();}
+   //The history at row, shared, or nullptr.
+   std::shared_ptr<const ClinicalValue> sharedHistory(size_t row) const
+   {
+      if (column_type != ClinicalType::History || !isValid(row))
+         return nullptr;
+      return history_values.at(row);
+   }
+};
+
+//The clinical values of a whole cohort, one column per field of a 
+//ClinicalSchema and one row per patient. Patients' ClinicalRecords can be
+//row views into a table (see PatientSet::buildClinicalTable), so scans of 
+//one field across the cohort read contiguous, typed memory.
+class ClinicalTable
+{
+private:
+   std::shared_ptr<ClinicalSchema> table_schema;
+   size_t n_patients;
+   std::vector<std::unique_ptr<ClinicalColumn>> columns;
+   ClinicalTable(const ClinicalTable&);              //Prevent copy-construction
+   ClinicalTable& operator=(const ClinicalTable&);   //Prevent assignment
+   void checkPosition(size_t f, size_t p) const;
+public:
+   ClinicalTable(std::shared_ptr<ClinicalSchema> S, size_t patients);
+   std::shared_ptr<ClinicalSchema> schema() const;
+   size_t patientCount() const;
+   size_t fieldCount() const;
+   void growToSchema();
+   const ClinicalColumn& column(size_t f) const;
+   const ClinicalColumn& column(const std::string& name) const;
+   CompactValue value(size_t f, size_t p) const;
+   //Takes ownership of v, as ClinicalRecord::setClinicalValue does.
+   void setValue(size_t f, size_t p, ClinicalValue* v);
+   //Strings v refers to are copied into the column's dictionary; v must not
+   //be a History value.
+   void setValue(size_t f, size_t p, CompactValue v);
+   //Shares h, which must be a History value, with the table.
+   void setHistory(size_t f, size_t p, std::shared_ptr<const ClinicalValue> h);
+   void setMissing(size_t f, size_t p);
+   void createIndex(size_t f);
+   void dropIndex(size_t f);
+   double mean(size_t f) const;
+};
+
+}//namespace patients
+}//namespace cge
+#endif
@@ -1,91 +1,335 @@
 #include "ClinicalValue.h"
+#include <algorithm>
 
 namespace cge{
    namespace patients{
 
-int compareDate(DateValue a_date, DateValue b_date) 
-//0 if dates are equal, negative if a comes first, positive if b comes first
+const char* typeName(ClinicalType t)
 {
-   if (a_date.year == b_date.year){
-      if (a_date.month == b_date.month){
-         return (a_date.day - b_date.day);
-      }
-      else{
-         return (a_date.month - b_date.month);
+   switch (t){
+      case ClinicalType::String: return "String";
+      case ClinicalType::Bool: return "Bool";
+      case ClinicalType::Date: return "Date";
+      case ClinicalType::Double: return "Double";
+      case ClinicalType::Int: return "Int";
+      case ClinicalType::History: return "History";
+      default: return "Missing";
+   }
+}
+
+namespace{
+
+template <typename T>
+bool compareAs(const T& a, CompareOp op, const T& b)
+{
+   switch (op){
+      case CompareOp::Equal: return a == b;
+      case CompareOp::NotEqual: return a != b;
+      case CompareOp::Less: return a < b;
+      case CompareOp::LessEqual: return a <= b;
+      case CompareOp::Greater: return a > b;
+      default: return a >= b;
+   }
+}
+
+bool isNumber(ClinicalType t)
+{
+   return t == ClinicalType::Int || t == ClinicalType::Double;
+}
+
+double asNumber(const CompactValue& v)
+{
+   return (v.typeTag() == ClinicalType::Int) ? v.asInt() : v.asDouble();
+}
+
+}
+
+bool compareValues(const CompactValue& a, CompareOp op, const CompactValue& b)
+{
+   if (a.isMissing() || b.isMissing())
+      return false;
+   ClinicalType t = a.typeTag();
+   if (t == ClinicalType::Int && b.typeTag() == ClinicalType::Int)
+      return compareAs(a.asInt(), op, b.asInt());
+   if (isNumber(t) && isNumber(b.typeTag()))
+      return compareAs(asNumber(a), op, asNumber(b));
+   if (t != b.typeTag() || t == ClinicalType::History)
+      throw std::invalid_argument(std::string("Cannot compare ") + 
+            typeName(t) + " with " + typeName(b.typeTag()));
+   switch (t){
+      case ClinicalType::Bool:
+         return compareAs(a.asBool(), op, b.asBool());
+      case ClinicalType::Date:
+         return compareAs(a.days(), op, b.days());
+      default:
+         return compareAs(a.asString(), op, b.asString());
+   }
+}
+
+CompactValue::CompactValue(const ClinicalValue* v) : 
+   value_type(v->typeTag()), boxed_value(nullptr)
+{
+   switch (value_type){
+      case ClinicalType::Int:
+         int_value = *static_cast<const IntValue*>(v);
+         break;
+      case ClinicalType::Double:
+         double_value = *static_cast<const DoubleValue*>(v);
+         break;
+      case ClinicalType::Bool:
+         bool_value = *static_cast<const BoolValue*>(v);
+         break;
+      case ClinicalType::Date:
+         date_value = static_cast<const DateValue*>(v)->days();
+         break;
+      case ClinicalType::String: 
+      case ClinicalType::History:
+         boxed_value = v;
+         break;
+      default:
+         break;
+   }
+}
+
+const std::string CompactValue::toString() const
+{
+   switch (value_type){
+      case ClinicalType::Int: return std::to_string(int_value);
+      case ClinicalType::Double: return std::to_string(double_value);
+      case ClinicalType::Bool: return bool_value ? "true" : "false";
+      case ClinicalType::Date: return asDate().toString();
+      case ClinicalType::String:
+      case ClinicalType::History: return boxed_value->toString();
+      default: return "?";
+   }
+}
+
+HistoryValue::HistoryValue(const std::string& s) : 
+   ClinicalValue(ClinicalType::History)
+{
+   std::vector<date::Days> dates;
+   std::vector<CompactValue> values;
+   std::vector<std::shared_ptr<const ClinicalValue>> boxed;
+   if (s.empty())
+      return;
+   std::vector<std::string> hist_items = utility::split(s,'\u001f');
+   for(auto i = hist_items.begin(); i != hist_items.end(); ++i){
+      std::vector<std::string> item = utility::split(*i, '\t');
+      if (item.size() < 3)
+         throw std::invalid_argument("Malformed history: " + *i);
+      //gets Clinical Value
+      std::shared_ptr<const ClinicalValue> b;
+      CompactValue v;
+      if(item[0].compare("String") == 0){
+         b.reset(new StringValue(item[1]));
+         v = CompactValue(b.get());
       }
+      else if(item[0].compare("Bool") == 0)
+         v = CompactValue(BoolValue(item[1]).operator bool());
+      else if(item[0].compare("Double") == 0)
+         v = CompactValue(std::stod(item[1]));
+      else if(item[0].compare("Int") == 0)
+         v = CompactValue(std::stoi(item[1]));
+      else if(item[0].compare("Date") == 0)
+         v = CompactValue(DateValue(item[1]));
+      //gets Date
+      dates.push_back(DateValue(item[2]).days());
+      values.push_back(v);
+      boxed.push_back(b);
+   }
+   assignPoints(dates, values, boxed);
+}
+
+void HistoryValue::insertPoint(size_t i, date::Days d, CompactValue v,
+      std::shared_ptr<const ClinicalValue> boxed)
+{
+   //only histories holding strings keep boxed_values
+   bool keep_boxed = boxed || !boxed_values.empty();
+   if (keep_boxed)
+      boxed_values.resize(point_dates.size());
+   if (i == point_dates.size()){
+      point_dates.push_back(d);
+      point_values.push_back(v);
+      if (keep_boxed)
+         boxed_values.push_back(boxed);
+   }
+   else{
+      point_dates.insert(point_dates.begin() + i, d);
+      point_values.insert(point_values.begin() + i, v);
+      if (keep_boxed)
+         boxed_values.insert(boxed_values.begin() + i, boxed);
    }
-   else
-      return (a_date.year - b_date.year);
 }
 
 bool HistoryValue::addDataPoint(const DateValue & d, ClinicalValue * v)
 {  
-   std::shared_ptr<ClinicalValue> share_v(v);
-   history_pair new_point = std::make_pair(d, share_v);
-   iterator i = begin();
-   while (i != end() && compareDate((*i).first, new_point.first) < 0){
-      ++i;
+   std::shared_ptr<const ClinicalValue> owned;
+   //the missing value is a singleton, never owned
+   if (v->typeTag() != ClinicalType::Missing)
+      owned.reset(v);
+   if (v->typeTag() == ClinicalType::History)
+      throw std::invalid_argument("A history cannot hold a history");
+   date::Days day = d.days();
+   //in order data is appended
+   size_t i = point_dates.size();
+   if (i > 0 && point_dates.back() >= day){
+      i = std::lower_bound(point_dates.begin(), point_dates.end(), day) - 
+         point_dates.begin();
+      if (point_dates[i] == day)
+         return false;
    }
-   if (compareDate((*i).first, new_point.first) == 0)
-      return false;
-   history_vector.insert (i, new_point);  
+   CompactValue compact(v);
+   insertPoint(i, day, compact, compact.isBoxed() ? owned : nullptr);
    return true;
 }
 
-bool HistoryValue::removeDataPoint(const DateValue & d)
+bool HistoryValue::addDataPoint(date::Days d, CompactValue v)
 {
-   iterator i = begin();
-   while (i != end()){
-      if (compareDate(d, (*i).first) == 0){
-         history_vector.erase(i);
-         return true;
-      }
-      ++i;
+   if (v.isBoxed())
+      throw std::invalid_argument("String and History values must be added "
+            "as a ClinicalValue");
+   size_t i = point_dates.size();
+   if (i > 0 && point_dates.back() >= d){
+      i = std::lower_bound(point_dates.begin(), point_dates.end(), d) - 
+         point_dates.begin();
+      if (point_dates[i] == d)
+         return false;
    }
-   return false;
+   insertPoint(i, d, v, nullptr);
+   return true;
 }
 
-ClinicalValue* HistoryValue::valueAtDate(const DateValue & d) const 
+void HistoryValue::assignPoints(const std::vector<date::Days>& dates, 
+      const std::vector<CompactValue>& values,
+      const std::vector<std::shared_ptr<const ClinicalValue>>& boxed)
 {
-   const_iterator i = begin();
-   ClinicalValue* result = &(MissingValue::Instance());
-   while (i != end()){
-      if (compareDate(d, (*i).first) >= 0){
-         result = ((*i).second).get();  
+   if (dates.size() != values.size())
+      throw std::invalid_argument("Dates and values differ in length");
+   bool has_boxed = false;
+   for (auto b = boxed.begin(); b != boxed.end() && !has_boxed; ++b)
+      has_boxed = (*b != nullptr);
+   point_dates.clear();
+   point_values.clear();
+   boxed_values.clear();
+   reserve(dates.size());
+   //order of the points by date, input order breaking ties
+   std::vector<size_t> order;
+   if (!std::is_sorted(dates.begin(), dates.end())){
+      order.resize(dates.size());
+      for (size_t i = 0; i < order.size(); ++i)
+         order[i] = i;
+      std::stable_sort(order.begin(), order.end(), 
+         [&dates](size_t a, size_t b) {return dates[a] < dates[b];});
+   }
+   for (size_t k = 0; k < dates.size(); ++k){
+      size_t i = order.empty() ? k : order[k];
+      //a repeated date keeps its last point
+      if (!point_dates.empty() && point_dates.back() == dates[i]){
+         point_values.back() = values[i];
+         if (has_boxed)
+            boxed_values.back() = boxed[i];
+         continue;
       }
-      ++i;
-   } 
-   return result;
+      point_dates.push_back(dates[i]);
+      point_values.push_back(values[i]);
+      if (has_boxed)
+         boxed_values.push_back(boxed[i]);
+   }
+}
+
+void HistoryValue::assign(const std::vector<date::Days>& dates, 
+      const std::vector<CompactValue>& values)
+{
+   for (auto v = values.begin(); v != values.end(); ++v){
+      if (v->isBoxed())
+         throw std::invalid_argument("String and History values must be "
+               "added as a ClinicalValue");
+   }
+   assignPoints(dates, values, 
+         std::vector<std::shared_ptr<const ClinicalValue>>());
 }
 
-const std::vector<ClinicalValue *> HistoryValue::valuesAsVector() const
+void HistoryValue::reserve(size_t n)
 {
-   std::vector<ClinicalValue *> temp;
-   for (const_iterator i = begin(); i != end(); ++i)
-      temp.push_back (((*i).second).get());
-   const std::vector<ClinicalValue *> val_vector = temp;
-   return val_vector;
+   point_dates.reserve(n);
+   point_values.reserve(n);
+}
+
+bool HistoryValue::removeDataPoint(const DateValue & d)
+{
+   date::Days day = d.days();
+   auto it = std::lower_bound(point_dates.begin(), point_dates.end(), day);
+   if (it == point_dates.end() || *it != day)
+      return false;
+   size_t i = it - point_dates.begin();
+   point_dates.erase(it);
+   point_values.erase(point_values.begin() + i);
+   if (!boxed_values.empty())
+      boxed_values.erase(boxed_values.begin() + i);
+   return true;
+}
+
+CompactValue HistoryValue::valueAtDate(const DateValue & d) const 
+{
+   return valueAtDate(d.days());
+}
+
+CompactValue HistoryValue::valueAtDate(date::Days d) const 
+{
+   //the first point after d
+   size_t i = std::upper_bound(point_dates.begin(), point_dates.end(), d) - 
+      point_dates.begin();
+   if (i == 0)
+      return CompactValue();
+   return point_values[i - 1];
+}
+
+std::pair<size_t,size_t> HistoryValue::pointsInRange(date::Days first, 
+      date::Days last) const
+{
+   size_t begin = std::lower_bound(point_dates.begin(), point_dates.end(), 
+         first) - point_dates.begin();
+   size_t end = std::upper_bound(point_dates.begin() + begin, 
+         point_dates.end(), last) - point_dates.begin();
+   return std::make_pair(begin, std::max(begin, end));
+}
+
+const std::vector<CompactValue>& HistoryValue::valuesAsVector() const
+{
+   return point_values;
 }
 
 const std::vector<DateValue> HistoryValue::datesAsVector() const
 {
-   std::vector<DateValue> temp;
-   for (const_iterator i = begin(); i != end(); ++i)
-      temp.push_back ((*i).first);
-   const std::vector<DateValue> date_vector = temp;
+   std::vector<DateValue> date_vector;
+   date_vector.reserve(point_dates.size());
+   for (auto d = point_dates.begin(); d != point_dates.end(); ++d)
+      date_vector.push_back(DateValue::fromDays(*d));
    return date_vector;
 }
 
-ClinicalValue* HistoryValue::value(size_t i) const
+const std::vector<date::Days>& HistoryValue::daysAsVector() const
+{
+   return point_dates;
+}
+
+CompactValue HistoryValue::value(size_t i) const
+{
+   if (i >= point_values.size())
+      return CompactValue();
+   return point_values[i];
+}
+
+date::Days HistoryValue::pointDate(size_t i) const
 {
-   if (i >= history_vector.size())
-      return &(MissingValue::Instance());
-   return ((history_vector.at(1)).second).get();
+   if (i >= point_dates.size())
+      throw std::out_of_range("This is not a valid position.");
+   return point_dates[i];
 }
 
 size_t HistoryValue::size() const 
 {
-   return history_vector.size();
+   return point_dates.size();
 }
 
 }//namespace patients
@@ -5,17 +5,34 @@
 #include <vector>
 #include <utility>
 #include <memory>
+#include <cstdint>
+#include <stdexcept>
 #include "Date.h"
 #include "StringFunctions.h"
 
 namespace cge{
    namespace patients{
   
+//The kinds of clinical value, so code can switch on a value's type instead
+//of comparing type() strings.
+enum class ClinicalType : uint8_t
+{
+   Missing, String, Bool, Date, Double, Int, History
+};
+
+//The name type() returns for t.
+const char* typeName(ClinicalType t);
+
 class ClinicalValue
 {
+private:
+   ClinicalType value_type;
+protected:
+   ClinicalValue(ClinicalType t) : value_type(t) { }
 public: 
    virtual ~ClinicalValue() = 0;   //Destructor
-   virtual const std::string type() const = 0;
+   ClinicalType typeTag() const {return value_type;}
+   const std::string type() const {return typeName(value_type);}
    virtual const std::string toString() const = 0;
 };
 inline ClinicalValue::~ClinicalValue() { }
@@ -23,7 +40,7 @@ inline ClinicalValue::~ClinicalValue() { }
 class MissingValue : public ClinicalValue
 {
 private: 
-   MissingValue(){}                                
+   MissingValue() : ClinicalValue(ClinicalType::Missing) {}
    ~MissingValue(){}                               
    MissingValue(const MissingValue&);              //Prevent copy-construction
    MissingValue& operator=(const MissingValue&);   //Prevent assignment
@@ -33,7 +50,6 @@ public:
       static MissingValue singleton;
       return singleton;
    }
-   const std::string type() const {return "Missing";}
    const std::string toString() const {return "?";}
 };
 
@@ -42,9 +58,10 @@ class StringValue : public ClinicalValue
 private:
    std::string value;
 public:
-   StringValue(std::string n) : value(n) {}
-   operator std::string() {return value;}
-   const std::string type() const {return "String";}
+   StringValue(std::string n) : 
+      ClinicalValue(ClinicalType::String), value(n) {}
+   operator std::string() const {return value;}
+   const std::string& str() const {return value;}
    const std::string toString() const {return value;}
 };
 
@@ -53,13 +70,12 @@ class BoolValue : public ClinicalValue
 private:
    bool value;
 public:
-   BoolValue(bool n) : value(n) {}
-   BoolValue(std::string s)
+   BoolValue(bool n) : ClinicalValue(ClinicalType::Bool), value(n) {}
+   BoolValue(std::string s) : ClinicalValue(ClinicalType::Bool)
    {
       value = s.compare("true");
    }
-   operator bool() {return value;}
-   const std::string type() const {return "Bool";}
+   operator bool() const {return value;}
    const std::string toString() const
    {
    if (value)
@@ -76,7 +92,8 @@ public:
    int month; 
    int year; 
 
-   DateValue(std::initializer_list<int> args)
+   DateValue(std::initializer_list<int> args) : 
+      ClinicalValue(ClinicalType::Date)
    {
       day = *(args.begin());
       month = *(args.begin() + 1);
@@ -84,7 +101,7 @@ public:
       if (!date::isValidDate(day, month, year))
             throw std::invalid_argument("Invalid Date");
    }
-   DateValue(int d, int m, int y)
+   DateValue(int d, int m, int y) : ClinicalValue(ClinicalType::Date)
    {
       day = d;
       month = m;
@@ -92,15 +109,22 @@ public:
       if (!date::isValidDate(day, month, year))
             throw std::invalid_argument("Invalid Date");
    }
-   DateValue(std::string s)
+   //s is an ISO 8601 date (see date::parseISODate).
+   DateValue(const std::string& s) : ClinicalValue(ClinicalType::Date)
    {
-      std::vector<std::string> date_info = utility::split(s,'-');
-      year = std::stoi(date_info[0]);
-      month = std::stoi(date_info[1]);
-      day = std::stoi(date_info[2]);
-      if (!date::isValidDate(day, month, year))
+      date::Days d;
+      if (!date::parseISODate(s.data(), s.size(), d))
             throw std::invalid_argument("Invalid Date");
+      date::civilFromDays(d, year, month, day);
    }
+   static DateValue fromDays(date::Days d)
+   {
+      int y, m, dd;
+      date::civilFromDays(d, y, m, dd);
+      return DateValue(dd, m, y);
+   }
+   //Days since 1970-01-01.
+   date::Days days() const {return date::daysFromCivil(year, month, day);}
    const std::string toString() const
    {
       std::string s_year = std::to_string(year);
@@ -109,7 +133,6 @@ public:
 
       return s_year + "-" + s_month + "-" + s_day;
    }
-   const std::string type() const {return "Date";}
 };
 
 class DoubleValue : public ClinicalValue
@@ -117,10 +140,10 @@ class DoubleValue : public ClinicalValue
 private:
    double value;
 public:
-   DoubleValue(double n) : value(n) {}
-   DoubleValue(std::string s) : value(std::stod(s)) {}
-   operator double() {return value;}
-   const std::string type() const {return "Double";}
+   DoubleValue(double n) : ClinicalValue(ClinicalType::Double), value(n) {}
+   DoubleValue(std::string s) : 
+      ClinicalValue(ClinicalType::Double), value(std::stod(s)) {}
+   operator double() const {return value;}
    const std::string toString() const {return (std::to_string(value));}
 };
 
@@ -129,87 +152,194 @@ class IntValue : public ClinicalValue
 private:
    int value;
 public:
-   IntValue(int n) : value(n) {}
-   IntValue(std::string s) : value(std::stoi(s)) {}
-   operator int() {return value;}
-   const std::string type() const {return "Int";}
+   IntValue(int n) : ClinicalValue(ClinicalType::Int), value(n) {}
+   IntValue(std::string s) : 
+      ClinicalValue(ClinicalType::Int), value(std::stoi(s)) {}
+   operator int() const {return value;}
    const std::string toString() const {return (std::to_string(value));}
 };
 
+class HistoryValue;
+
+//A clinical value in 16 bytes, tagged with its type. Int, Double, Bool and
+//Date values are held inline; strings and histories are referred to, and
+//must outlive the CompactValue. Records store these contiguously, so reading
+//a value is a load and a switch on typeTag() rather than a virtual call.
+class CompactValue
+{
+private:
+   ClinicalType value_type;
+   union{
+      int32_t int_value;
+      double double_value;
+      bool bool_value;
+      date::Days date_value;
+      const ClinicalValue* boxed_value;
+   };
+
+   void checkType(ClinicalType t) const
+   {
+      if (value_type != t)
+         throw std::invalid_argument(std::string("Value is not a ") + 
+               typeName(t) + " value");
+   }
+public:
+   CompactValue() : value_type(ClinicalType::Missing), boxed_value(nullptr) 
+   { }
+   explicit CompactValue(int v) : value_type(ClinicalType::Int), int_value(v)
+   { }
+   explicit CompactValue(double v) : 
+      value_type(ClinicalType::Double), double_value(v)
+   { }
+   explicit CompactValue(bool v) : value_type(ClinicalType::Bool), 
+      bool_value(v)
+   { }
+   explicit CompactValue(const DateValue& d) : value_type(ClinicalType::Date),
+      date_value(d.days())
+   { }
+   static CompactValue fromDays(date::Days d)
+   {
+      CompactValue v;
+      v.value_type = ClinicalType::Date;
+      v.date_value = d;
+      return v;
+   }
+   //Copies inline types out of v; strings and histories are referred to.
+   explicit CompactValue(const ClinicalValue* v);
+
+   ClinicalType typeTag() const {return value_type;}
+   bool isMissing() const {return value_type == ClinicalType::Missing;}
+   //true for the types held by reference
+   bool isBoxed() const
+   {
+      return value_type == ClinicalType::String || 
+         value_type == ClinicalType::History;
+   }
+
+   //These throw std::invalid_argument if the value has another type.
+   int asInt() const
+   {
+      checkType(ClinicalType::Int);
+      return int_value;
+   }
+   double asDouble() const
+   {
+      checkType(ClinicalType::Double);
+      return double_value;
+   }
+   bool asBool() const
+   {
+      checkType(ClinicalType::Bool);
+      return bool_value;
+   }
+   DateValue asDate() const
+   {
+      checkType(ClinicalType::Date);
+      return DateValue::fromDays(date_value);
+   }
+   //Days since 1970-01-01, so dates compare as ints.
+   date::Days days() const
+   {
+      checkType(ClinicalType::Date);
+      return date_value;
+   }
+   const std::string& asString() const
+   {
+      checkType(ClinicalType::String);
+      return static_cast<const StringValue*>(boxed_value)->str();
+   }
+   const HistoryValue& asHistory() const;
+   //The string or history referred to, nullptr for other types.
+   const ClinicalValue* boxed() const
+   {
+      return isBoxed() ? boxed_value : nullptr;
+   }
+
+   //Formatted as the ClinicalValue of the same type would be.
+   const std::string toString() const;
+};
+
+enum class CompareOp : uint8_t
+{
+   Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual
+};
+
+//a op b. Ints and Doubles compare as numbers, Bools with false before true,
+//Strings lexicographically and Dates by day. False if either is missing.
+//Throws std::invalid_argument for other pairs of types.
+bool compareValues(const CompactValue& a, CompareOp op, const CompactValue& b);
+
+//A time series of clinical values. Points are kept in date order as 
+//parallel arrays of day numbers and CompactValues, so as-of and range 
+//lookups are binary searches over contiguous dates, and appending points in
+//date order is amortized O(1).
 class HistoryValue : public ClinicalValue
 {
 private: 
-   std::vector<std::pair<DateValue,std::shared_ptr<ClinicalValue>>> 
-      history_vector;
+   std::vector<date::Days> point_dates;
+   std::vector<CompactValue> point_values;
+   //the strings that point_values refer to, at the same positions; empty 
+   //until one is added
+   std::vector<std::shared_ptr<const ClinicalValue>> boxed_values;
+
+   void insertPoint(size_t i, date::Days d, CompactValue v, 
+         std::shared_ptr<const ClinicalValue> boxed);
+   void assignPoints(const std::vector<date::Days>& dates, 
+         const std::vector<CompactValue>& values,
+         const std::vector<std::shared_ptr<const ClinicalValue>>& boxed);
 public: 
-   typedef std::pair<DateValue,std::shared_ptr<ClinicalValue>> history_pair;
-   typedef std::vector<history_pair>::iterator iterator; 
-   typedef std::vector<history_pair>::const_iterator const_iterator; 
-   
-   HistoryValue()
-   {
-      history_vector.reserve(1);
-   } 
-   HistoryValue(std::string s)
-   {
-      history_vector.reserve(1);
-      std::vector<std::string> hist_items = utility::split(s,'\u001f');
-      for(auto i = hist_items.begin(); i != hist_items.end(); ++i){
-         std::vector<std::string> item = utility::split(*i, '\t');
-         //gets Clinical Value
-         ClinicalValue* v;
-         if(item[0].compare("String") == 0)
-            v = new StringValue(item[1]);
-         else if(item[0].compare("Bool") == 0)
-            v = new BoolValue(item[1]);
-         else if(item[0].compare("Double") == 0)
-            v = new DoubleValue(item[1]);
-         else if(item[0].compare("Int") == 0)
-            v = new IntValue(item[1]);
-         else if(item[0].compare("Date") == 0)
-            v = new DateValue(item[1]);       
-         else
-            v = &MissingValue::Instance();
-         //gets Date
-         DateValue d(item[2]);
-         //adds data point to history
-         this->addDataPoint(d, v);
-      }
-   }
+   HistoryValue() : ClinicalValue(ClinicalType::History) { }
+   //s is a history as written by toString().
+   HistoryValue(const std::string& s);
+
+   //Takes ownership of v. Returns false, deleting v, if there is already a
+   //point at d.
    bool addDataPoint(const DateValue & d, ClinicalValue* v);
+   //v must not be a String or History value, which have to be passed as
+   //ClinicalValue.
+   bool addDataPoint(date::Days d, CompactValue v);
+   //Replaces the points with (dates[i], values[i]) in one pass, sorting 
+   //them if need be. Where a date repeats, its last point is kept. The 
+   //values must not be String or History values.
+   void assign(const std::vector<date::Days>& dates, 
+         const std::vector<CompactValue>& values);
+   void reserve(size_t n);
    bool removeDataPoint(const DateValue & d);
-   ClinicalValue* valueAtDate(const DateValue & d) const; 
-   const std::vector<ClinicalValue*> valuesAsVector() const;
+   //The value of the last point at or before d, missing if there is none.
+   CompactValue valueAtDate(const DateValue & d) const; 
+   CompactValue valueAtDate(date::Days d) const; 
+   //Positions [begin, end) of the points dated from first to last, 
+   //inclusive.
+   std::pair<size_t,size_t> pointsInRange(date::Days first, 
+         date::Days last) const;
+   const std::vector<CompactValue>& valuesAsVector() const;
    const std::vector<DateValue> datesAsVector() const;
-   ClinicalValue* value(size_t i) const;
+   const std::vector<date::Days>& daysAsVector() const;
+   CompactValue value(size_t i) const;
+   date::Days pointDate(size_t i) const;
    size_t size() const;
 
-   iterator begin() {return history_vector.begin();}
-   const_iterator begin() const {return history_vector.begin();}
-   iterator end() {return history_vector.end();}
-   const_iterator end() const {return history_vector.end();}
-   
-   const std::string type() const {return "History";}
    const std::string toString() const
    {
       std::string hist_line;
-      const std::vector<ClinicalValue*> hist_vals = valuesAsVector();
-      const std::vector<DateValue> hist_dates = datesAsVector();
-      ClinicalValue* temp;
-         for (size_t i = 0; i < hist_vals.size(); ++i){
-            temp = hist_vals.at(i);
-            hist_line.append(temp->type() + '\t');
-            hist_line.append(temp->toString() + '\t');
-            hist_line.append(hist_dates.at(i).toString());
-         
-            if (i + 1 < hist_vals.size())
-               hist_line.append("\u001f");
-         }
+      for (size_t i = 0; i < size(); ++i){
+         hist_line.append(std::string(typeName(point_values[i].typeTag())) + 
+               '\t');
+         hist_line.append(point_values[i].toString() + '\t');
+         hist_line.append(DateValue::fromDays(point_dates[i]).toString());
+         if (i + 1 < size())
+            hist_line.append("\u001f");
+      }
       return hist_line;
    }
-
 };
 
+inline const HistoryValue& CompactValue::asHistory() const
+{
+   checkType(ClinicalType::History);
+   return *static_cast<const HistoryValue*>(boxed_value);
+}
+
 }//namespace patients
 }//namespace cge
 #endif
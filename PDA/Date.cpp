@@ -1,3 +1,5 @@
+#include "Date.h"
+
 namespace date
 {
    bool isLeapYear(int y)
@@ -35,4 +37,96 @@ namespace date
       }
       return is_valid;
       }
+
+   //Counts days in 400 year eras of 146097 days, with years starting in 
+   //March so the leap day comes last.
+   Days daysFromCivil(int year, int month, int day)
+   {
+      year -= month <= 2;
+      int era = (year >= 0 ? year : year - 399) / 400;
+      int year_of_era = year - era * 400;
+      int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + 
+         day - 1;
+      int day_of_era = year_of_era * 365 + year_of_era / 4 - 
+         year_of_era / 100 + day_of_year;
+      return era * 146097 + day_of_era - 719468;
+   }
+
+   void civilFromDays(Days d, int& year, int& month, int& day)
+   {
+      int z = d + 719468;
+      int era = (z >= 0 ? z : z - 146096) / 146097;
+      int day_of_era = z - era * 146097;
+      int year_of_era = (day_of_era - day_of_era / 1460 + 
+            day_of_era / 36524 - day_of_era / 146096) / 365;
+      int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - 
+            year_of_era / 100);
+      int m = (5 * day_of_year + 2) / 153;
+      day = day_of_year - (153 * m + 2) / 5 + 1;
+      month = m < 10 ? m + 3 : m - 9;
+      year = year_of_era + era * 400 + (month <= 2);
+   }
+
+   bool parseISODate(const char* s, size_t n, Days& out)
+   {
+      int year, month, day;
+      //the common padded form, checked in one go
+      if (n >= 10 && s[4] == '-' && s[7] == '-' && 
+            (n == 10 || s[10] == 'T' || s[10] == ' ')){
+         unsigned d[8] = {
+            (unsigned)(s[0] - '0'), (unsigned)(s[1] - '0'), 
+            (unsigned)(s[2] - '0'), (unsigned)(s[3] - '0'), 
+            (unsigned)(s[5] - '0'), (unsigned)(s[6] - '0'),
+            (unsigned)(s[8] - '0'), (unsigned)(s[9] - '0')};
+         if ((d[0] > 9) | (d[1] > 9) | (d[2] > 9) | (d[3] > 9) | 
+               (d[4] > 9) | (d[5] > 9) | (d[6] > 9) | (d[7] > 9))
+            return false;
+         year = d[0] * 1000 + d[1] * 100 + d[2] * 10 + d[3];
+         month = d[4] * 10 + d[5];
+         day = d[6] * 10 + d[7];
+      }
+      else{
+         //year-month-day with any number of digits in each part
+         int parts[3] = {0, 0, 0};
+         size_t i = 0;
+         for (int p = 0; p < 3; ++p){
+            size_t start = i;
+            while (i < n && (unsigned)(s[i] - '0') <= 9 && i - start < 9)
+               parts[p] = parts[p] * 10 + (s[i++] - '0');
+            if (i == start)
+               return false;
+            if (p < 2){
+               if (i >= n || s[i] != '-')
+                  return false;
+               ++i;
+            }
+         }
+         if (i < n && s[i] != 'T' && s[i] != ' ')
+            return false;
+         year = parts[0];
+         month = parts[1];
+         day = parts[2];
+      }
+      if (!isValidDate(day, month, year))
+         return false;
+      out = daysFromCivil(year, month, day);
+      return true;
+   }
+
+   void inRange(const Days* days, size_t n, Days first, Days last, 
+         uint64_t* out)
+   {
+      //first <= d <= last as one unsigned compare
+      uint32_t width = (uint32_t)last - (uint32_t)first;
+      bool empty = last < first;
+      for (size_t w = 0; w * 64 < n; ++w){
+         size_t count = (n - w * 64 < 64) ? n - w * 64 : 64;
+         const Days* block = days + w * 64;
+         uint64_t bits = 0;
+         for (size_t k = 0; k < count; ++k)
+            bits |= (uint64_t)((uint32_t)block[k] - (uint32_t)first <= width) 
+               << k;
+         out[w] = empty ? 0 : bits;
+      }
+   }
 }
@@ -1,8 +1,30 @@
 #ifndef DATE_H
 #define DATE_H
+
+#include <cstddef>
+#include <cstdint>
+
 namespace date
 {
    bool isLeapYear(int y);
    bool isValidDate(int day, int month, int year);
+
+   //A date as the number of days since 1970-01-01, so dates compare and 
+   //subtract as ints.
+   typedef int32_t Days;
+
+   Days daysFromCivil(int year, int month, int day);
+   void civilFromDays(Days d, int& year, int& month, int& day);
+
+   //Parses the n chars at s as an ISO 8601 date, "2014-03-07" or the 
+   //unpadded "2014-3-7", ignoring a trailing time ("T..." or " ..."). 
+   //Returns false, leaving out alone, if s is not a valid date. Nothing is 
+   //allocated.
+   bool parseISODate(const char* s, size_t n, Days& out);
+
+   //Sets bit i of out (n / 64 rounded up words) if first <= days[i] <= last.
+   //The loop has no branches on the data, so the compiler can vectorize it.
+   void inRange(const Days* days, size_t n, Days first, Days last, 
+         uint64_t* out);
 }
 #endif
@@ -0,0 +1,138 @@
+#include "DbSNPIndex.h"
+#include "StringFunctions.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+
+namespace cge{
+   namespace patients{
+
+namespace{
+
+const char index_magic[8] = {'C','G','E','S','N','P','1','\0'};
+const size_t header_size = 16;   //magic then a 64 bit record count
+
+bool recordLess(const DbSNPRecord& a, const DbSNPRecord& b)
+{
+   if (a.chrom != b.chrom)
+      return a.chrom < b.chrom;
+   if (a.pos != b.pos)
+      return a.pos < b.pos;
+   return a.rs_id < b.rs_id;
+}
+
+}
+
+const char* const DbSNPIndex::DefaultPath = "snp138.idx";
+
+DbSNPIndex::DbSNPIndex(const std::string& path, const ReferenceGenome& ref) :
+   records(nullptr), n_records(0), ref_name(ref.name())
+{
+   index_file.reset(new utility::MappedFile(path));
+   if (index_file->size() < header_size || 
+         std::memcmp(index_file->data(), index_magic, 8) != 0)
+      throw std::runtime_error("Not a dbSNP index: " + path);
+   uint64_t count;
+   std::memcpy(&count, index_file->data() + 8, sizeof(count));
+   if (index_file->size() != header_size + count * sizeof(DbSNPRecord))
+      throw std::runtime_error("Truncated dbSNP index: " + path);
+   records = reinterpret_cast<const DbSNPRecord*>
+      (index_file->data() + header_size);
+   n_records = count;
+}
+
+DbSNPIndex* DbSNPIndex::openDefault()
+{
+   try{
+      return new DbSNPIndex(DefaultPath, GENOME_HG19::Instance());
+   }
+   catch(std::runtime_error&){
+      return nullptr;
+   }
+}
+
+const DbSNPIndex* DbSNPIndex::Instance(const ReferenceGenome& ref)
+{
+   if (ref.name() != GENOME_HG19::Instance().name())
+      return nullptr;
+   static std::unique_ptr<DbSNPIndex> hg19(openDefault());
+   return hg19.get();
+}
+
+size_t DbSNPIndex::build(std::istream& snp_table, std::ostream& index)
+{
+   std::vector<DbSNPRecord> table;
+   std::vector<utility::StringRef> cols;
+   std::string line;
+   while (std::getline(snp_table, line)){
+      if (line.empty() || line[0] == '#')
+         continue;
+      if (utility::split(utility::StringRef(line), '\t', cols) < 3)
+         throw std::invalid_argument("Malformed snp table line: " + line);
+      utility::StringRef chrom = cols[0];
+      if (chrom.size > 3 && std::memcmp(chrom.data, "chr", 3) == 0)
+         chrom = utility::StringRef(chrom.data + 3, chrom.size - 3);
+      //skips chrX, chrM, chr6_apd_hap1 and other unnumbered sequences
+      if (chrom.empty() || std::find_if(chrom.begin(), chrom.end(), 
+            [](char c){return c < '0' || c > '9';}) != chrom.end())
+         continue;
+      const utility::StringRef& name = cols[2];
+      if (name.size < 3 || name[0] != 'r' || name[1] != 's' ||
+            name[2] < '0' || name[2] > '9')
+         continue;
+      DbSNPRecord r;
+      r.chrom = (int32_t)utility::toInteger(chrom);
+      //chromStart is 0-based
+      r.pos = (uint32_t)utility::toInteger(cols[1]) + 1;
+      r.rs_id = (uint32_t)utility::toInteger(
+            utility::StringRef(name.data + 2, name.size - 2));
+      table.push_back(r);
+   }
+   std::sort(table.begin(), table.end(), recordLess);
+   uint64_t count = table.size();
+   index.write(index_magic, 8);
+   index.write(reinterpret_cast<const char*>(&count), sizeof(count));
+   if (!table.empty())
+      index.write(reinterpret_cast<const char*>(table.data()), 
+            table.size() * sizeof(DbSNPRecord));
+   if (!index)
+      throw std::runtime_error("Could not write dbSNP index");
+   return table.size();
+}
+
+size_t DbSNPIndex::build(const std::string& snp_table_path, 
+      const std::string& index_path)
+{
+   std::ifstream snp_table(snp_table_path.c_str());
+   if (!snp_table)
+      throw std::runtime_error("Could not open " + snp_table_path);
+   std::ofstream index(index_path.c_str(), std::ios::out | std::ios::binary);
+   if (!index)
+      throw std::runtime_error("Could not open " + index_path);
+   return build(snp_table, index);
+}
+
+const DbSNPRecord* DbSNPIndex::find(int chrom, int pos) const
+{
+   DbSNPRecord key;
+   key.chrom = chrom;
+   key.pos = (uint32_t)pos;
+   key.rs_id = 0;
+   const DbSNPRecord* it = std::lower_bound(begin(), end(), key, recordLess);
+   if (it == end() || it->chrom != chrom || it->pos != (uint32_t)pos)
+      return nullptr;
+   return it;
+}
+
+std::string DbSNPIndex::lookup(int chrom, int pos) const
+{
+   const DbSNPRecord* r = find(chrom, pos);
+   if (r == nullptr)
+      return "";
+   return "rs" + std::to_string(r->rs_id);
+}
+
+}//namespace patients
+}//namespace cge
@@ -0,0 +1,70 @@
+#ifndef DBSNPINDEX_H
+#define DBSNPINDEX_H
+
+#include <string>
+#include <memory>
+#include <iostream>
+#include <cstdint>
+#include "MappedFile.h"
+#include "ReferenceGenome.h"
+
+namespace cge{
+   namespace patients{
+
+//One dbSNP entry of a binary index file. Positions are 1-based, like
+//GenomicLocation; rs_id is the number after "rs".
+struct DbSNPRecord
+{
+   int32_t chrom;
+   uint32_t pos;
+   uint32_t rs_id;
+};
+
+//Read-only rs number lookup over a binary index written by build(). The
+//file is memory mapped and holds the records, in host byte order, sorted by
+//chromosome and position, so a lookup is a binary search with no parsing.
+//Positions are only meaningful on the reference the index was built from.
+class DbSNPIndex
+{
+private:
+   std::unique_ptr<utility::MappedFile> index_file;
+   const DbSNPRecord* records;
+   size_t n_records;
+   std::string ref_name;
+   DbSNPIndex(const DbSNPIndex&);              //Prevent copy-construction
+   DbSNPIndex& operator=(const DbSNPIndex&);   //Prevent assignment
+   static DbSNPIndex* openDefault();
+public:
+   //dbSNP 138, which is on GENOME_HG19
+   static const char* const DefaultPath;
+
+   //Maps the index at path, built from dbSNP on ref. Throws 
+   //std::runtime_error if it is not an index.
+   DbSNPIndex(const std::string& path, const ReferenceGenome& ref);
+
+   //The index for ref, mapped on first use: DefaultPath for GENOME_HG19.
+   //Returns nullptr if ref has no index or its file is missing.
+   static const DbSNPIndex* Instance(const ReferenceGenome& ref);
+
+   //Converts a UCSC snp table dump (tab separated chrom, chromStart, name,
+   //as described in the README) to a binary index. Entries on chromosomes
+   //without a number and names that are not rs numbers are left out.
+   //Returns the number of records written.
+   static size_t build(std::istream& snp_table, std::ostream& index);
+   static size_t build(const std::string& snp_table_path, 
+         const std::string& index_path);
+
+   //The name of the reference the positions are on.
+   const std::string& reference() const {return ref_name;}
+   size_t size() const {return n_records;}
+   const DbSNPRecord* begin() const {return records;}
+   const DbSNPRecord* end() const {return records + n_records;}
+
+   //The rs number ("rs1234") at chrom and pos, or "" if there is none.
+   std::string lookup(int chrom, int pos) const;
+   const DbSNPRecord* find(int chrom, int pos) const;
+};
+
+}//namespace patients
+}//namespace cge
+#endif
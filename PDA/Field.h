@@ -13,13 +13,14 @@ private:
    std::shared_ptr<const ClinicalField> clin_field;
    std::shared_ptr<const VariantField> var_field;
 public:
+   //The schemas own their fields, so these pointers never delete them.
    Field(const ClinicalField* c) : 
-      clin_field((std::shared_ptr<const ClinicalField>) c),
+      clin_field(c, [](const ClinicalField*) { }),
       var_field(std::shared_ptr<const VariantField>(nullptr))
    { }
    Field(const VariantField* v) : 
       clin_field (std::shared_ptr<const ClinicalField>(nullptr)),
-      var_field((std::shared_ptr<const VariantField>) v)  
+      var_field(v, [](const VariantField*) { })  
    { }
    bool isClinical()
    {
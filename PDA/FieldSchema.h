@@ -6,6 +6,8 @@
 #include<stdexcept>
 #include<limits>
 #include<algorithm>
+#include<unordered_map>
+#include<unordered_set>
 
 namespace cge{
    namespace patients{
@@ -16,7 +18,20 @@ class FieldSchema
 private: 
    std::vector<T*> field_list;
    std::vector<bool> visible_list;
+   //position of every non-null field in field_list, by name
+   std::unordered_map<std::string, size_t> name_index;
    void swap(int i, int j);
+   void indexField(size_t i);
+   void unindexField(size_t i);
+protected:
+   //Called once the non-null field at i is in place, and before it is moved
+   //or removed, so subclasses can keep their own indexes in sync.
+   virtual void fieldIndexed(size_t) { }
+   virtual void fieldUnindexed(size_t) { }
+   //Called by reserve so subclasses can size their own indexes.
+   virtual void fieldsReserved(size_t) { }
+   const T* storedField(size_t i) const {return field_list.at(i);}
+   bool isVisible(size_t i) const {return visible_list.at(i);}
 public: 
    const size_t NonExistantField = std::numeric_limits<size_t>::max(); 
    FieldSchema()
@@ -24,7 +39,10 @@ public:
       field_list.reserve(1);
       visible_list.reserve(1);
    }
+   virtual ~FieldSchema() { }
    size_t appendField (T* f);
+   size_t appendFields (const std::vector<T*>& fields);
+   void reserve(size_t n);
    void setField(size_t i, T* f);
    void removeField(size_t i);
    bool restrictToFields(const std::vector<std::string> & names);
@@ -38,6 +56,8 @@ public:
    std::string name(size_t i);
    const std::vector<std::string> fieldNames() const;
    void setFieldOrder(const std::vector<std::string> & order);
+   //Fields must not be renamed (or relocated, in a GenotypeSchema) through
+   //these iterators, the schema indexes them.
    typename std::vector<T*>::iterator begin()
    {
       return field_list.begin();
@@ -54,32 +74,66 @@ template <typename T>
 size_t FieldSchema<T>::appendField (T* f)
 {
    //check if field is already in schema
-   for(auto it = begin();it!=end();++it){
-      if ((*it) != NULL &&(((*it)->name()).compare(f->name()) == 0))
-         throw std::invalid_argument ("This field already exists.");
-   }
+   if (name_index.count(f->name()) > 0)
+      throw std::invalid_argument ("This field already exists.");
    //inserts field
    field_list.push_back(f);
    visible_list.push_back(true);
+   indexField(size() - 1);
    return ((this->size()) - 1);
 }
 
+//Appends every field in fields, or none of them if any name is already in
+//the schema or appears twice in fields. Returns the position of the first.
+template <typename T>
+size_t FieldSchema<T>::appendFields (const std::vector<T*>& fields)
+{
+   //checks the whole batch before changing anything
+   std::unordered_set<std::string> batch_names;
+   batch_names.reserve(fields.size());
+   for(auto it = fields.begin(); it != fields.end(); ++it){
+      if (name_index.count((*it)->name()) > 0 || 
+            !batch_names.insert((*it)->name()).second)
+         throw std::invalid_argument ("This field already exists: " + 
+               (*it)->name());
+   }
+   //inserts fields
+   size_t first = size();
+   reserve(first + fields.size());
+   for(auto it = fields.begin(); it != fields.end(); ++it){
+      field_list.push_back(*it);
+      visible_list.push_back(true);
+      indexField(size() - 1);
+   }
+   return first;
+}
+
+template <typename T>
+void FieldSchema<T>::reserve(size_t n)
+{
+   field_list.reserve(n);
+   visible_list.reserve(n);
+   name_index.reserve(n);
+   fieldsReserved(n);
+}
+
 template <typename T>
 void FieldSchema<T>::setField(size_t i, T* f)
 {
    //check if field is already in schema
-   for(auto it = begin();it!=end();++it){
-      if ((*it) != NULL && (((*it)->name()).compare(f->name()) == 0))
-         throw std::invalid_argument ("This field already exists.");
-   }
+   auto found = name_index.find(f->name());
+   if (found != name_index.end() && found->second != i)
+      throw std::invalid_argument ("This field already exists.");
    //check if size of field_list is big enough
    if (size() <= i){
       field_list.resize(i + 1);
       visible_list.resize(i + 1, true);
    }
    //adds f
+   unindexField(i);
    field_list.at(i) = f;
    visible_list.at(i) = true;
+   indexField(i);
 }
 
 template <typename T>
@@ -88,11 +142,34 @@ void FieldSchema<T>::removeField(size_t i)
    if (size() <= i || (visible_list.at(i)) == false)
       throw std::out_of_range("This field does not exist in the schema.");
    else{
+      //the fields after i move down one position
+      for (size_t j = i; j < size(); ++j)
+         unindexField(j);
       field_list.erase(begin() + i);
       visible_list.erase(visible_list.begin() + i);
+      for (size_t j = i; j < size(); ++j)
+         indexField(j);
    }
 }
 
+template <typename T>
+void FieldSchema<T>::indexField(size_t i)
+{
+   if (field_list.at(i) == NULL)
+      return;
+   name_index[field_list.at(i)->name()] = i;
+   fieldIndexed(i);
+}
+
+template <typename T>
+void FieldSchema<T>::unindexField(size_t i)
+{
+   if (field_list.at(i) == NULL)
+      return;
+   fieldUnindexed(i);
+   name_index.erase(field_list.at(i)->name());
+}
+
 template <typename T>
 bool FieldSchema<T>::restrictToFields(const std::vector<std::string> & names)
 {
@@ -104,8 +181,9 @@ bool FieldSchema<T>::restrictToFields(const std::vector<std::string> & names)
       if(!hasField(*i))
          all_exist = false;
    //sets new restrictions
-   for(int i = 0; i < size(); ++i){
-      if(std::find(names.begin(), names.end(), name(i)) == names.end())
+   std::unordered_set<std::string> kept(names.begin(), names.end());
+   for(size_t i = 0; i < size(); ++i){
+      if(field_list.at(i) != NULL && kept.count(field_list.at(i)->name()) == 0)
          visible_list.at(i) = false;
    }
    return all_exist;
@@ -130,14 +208,14 @@ size_t FieldSchema<T>::size() const
    return field_list.size();
 }
 
+//Fields hidden by restrictToFields are not found.
 template <typename T>
 size_t FieldSchema<T>::indexOfField(const std::string & name) const 
 {
-   for (size_t i = 0; i < size(); ++i){
-      if ((field(i) != NULL) && ((field(i)->name()).compare(name) == 0))
-         return i;
-   }
-   return NonExistantField;
+   auto found = name_index.find(name);
+   if (found == name_index.end() || visible_list.at(found->second) == false)
+      return NonExistantField;
+   return found->second;
 }
 
 template <typename T>
@@ -184,9 +262,14 @@ const std::vector<std::string> FieldSchema<T>::fieldNames() const
 template <typename T>
 void FieldSchema<T>::swap(int i, int j)
 {
-   T* temp =  this->field(i);
-   field_list.at(i) = this->field(j);
-   field_list.at(j) = temp;
+   if (i == j)
+      return;
+   unindexField(i);
+   unindexField(j);
+   std::swap(field_list.at(i), field_list.at(j));
+   std::vector<bool>::swap(visible_list.at(i), visible_list.at(j));
+   indexField(i);
+   indexField(j);
 }
 
 template <typename T>
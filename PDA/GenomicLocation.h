@@ -6,6 +6,7 @@
 #include <sstream>
 #include "ReferenceGenome.h"
 #include "StringFunctions.h"
+#include "LocationCache.h"
 
 namespace cge{
    namespace patients{
@@ -45,34 +46,20 @@ public:
    
    const ReferenceGenome* refGenome() const {return ref_genome;}
 
-   void setRefGenome(ReferenceGenome ref) {ref_genome = &ref;}
+   void setRefGenome(ReferenceGenome& ref) {ref_genome = &ref;}
 
+   //Looks up the rs number at this location in the dbSNP index for its
+   //reference (see DbSNPIndex), through the process-wide LocationCache. 
+   //Returns "rs" if there is none or the reference has no index.
    std::string lookupRS() const
    {
-      std::ifstream snps("snp138.txt");
-      if(!snps)
+      if (ref_genome == nullptr)
          return "rs";
-      std::string chrom = "chr" + chromosome();
-      std::string pos = "" + position();
-      bool foundChromNum = false;
-      std::string line;
-      std::vector<std::string> info;
-      //skips over header line
-      std::getline(snps, line);
-      //begins searching
-      while(snps.good()){
-         std::getline(snps, line);
-         info = utility::split(line, '\t');
-         if (info[0].compare(chrom) == 0){
-            foundChromNum = true;
-            if (info[1].compare(pos) == 0)
-               return info[2];
-         }
-         //stops searching once past chromosome number
-         else if (foundChromNum)
-            return "rs";
-      }
-      return "rs";
+      std::string rs = LocationCache::Instance().resolveRS(*ref_genome, 
+            chromosome(), position());
+      if (rs.empty())
+         return "rs";
+      return rs;
    }
 };
 
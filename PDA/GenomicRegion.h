@@ -0,0 +1,29 @@
+#ifndef GENOMICREGION_H
+#define GENOMICREGION_H
+
+namespace cge{
+   namespace patients{
+
+//A stretch of one chromosome, from position first through position last
+//(1-based and inclusive, the same coordinates as GenomicLocation).
+struct GenomicRegion
+{
+   int chrom;
+   int first;
+   int last;
+
+   GenomicRegion(int c, int f, int l) : chrom(c), first(f), last(l) { }
+};
+
+inline bool operator<(const GenomicRegion& lhs, const GenomicRegion& rhs)
+{
+   if (lhs.chrom != rhs.chrom)
+      return lhs.chrom < rhs.chrom;
+   if (lhs.first != rhs.first)
+      return lhs.first < rhs.first;
+   return lhs.last < rhs.last;
+}
+
+}//namespace patients
+}//namespace cge
+#endif
@@ -1,16 +1,43 @@
 #include "Genotype.h"
 #include <utility>
+#include <algorithm>
 
 namespace cge{
    namespace patients{
    
+//A view of the calls of patient column in M. Writes go to M.
+Genotype::Genotype(std::shared_ptr<GenotypeMatrix> M, size_t column) : 
+   genotype_schema(M->schema()), is_packed(true), matrix(M), 
+   matrix_column(column), pop(nullptr)
+{
+   if (column >= M->patientCount())
+      throw std::out_of_range("This column doesn't exist in the matrix");
+}
+
+//Copies the calls out of the matrix into this Genotype's own storage.
+void Genotype::detachFromMatrix()
+{
+   std::vector<char> calls;
+   matrix->patientCalls(matrix_column, calls);
+   matrix.reset();
+   packed_variants = PackedGenotypes();
+   packed_variants.resize(calls.size());
+   for (size_t i = 0; i < calls.size(); ++i)
+      packed_variants.set(i, calls[i]);
+   is_packed = true;
+}
+
 std::shared_ptr<GenotypeSchema> Genotype::schema()
 {
   return genotype_schema;
 }
 
+//Giving a matrix view a different schema turns it into a Genotype of its
+//own.
 void Genotype::setSchema(std::shared_ptr<GenotypeSchema> S)
 {
+   if (matrix && S != matrix->schema())
+      detachFromMatrix();
    genotype_schema = S;
 }
 
@@ -23,12 +50,30 @@ void Genotype::setVariant(size_t i, char v)
 {
    if (i >= (this->size()))
       throw std::out_of_range("This position doesn't exist in the schema");
-   if (i >= variants.size())
-      variants.resize(this->size());
-   if (this->schema()->field(i)->variant(v) == "")
+   if (v != MissingVariant && this->schema()->field(i)->variant(v) == "")
       throw std::out_of_range("No variant exists at this index.");
-   variants.at(i) = v;
-   
+   if (matrix){
+      if (PackedGenotypes::fits(v)){
+         matrix->setVariant(i, matrix_column, v);
+         return;
+      }
+      detachFromMatrix();
+   }
+   if (is_packed && !PackedGenotypes::fits(v)){
+      wide_variants = packed_variants.unpack();
+      packed_variants = PackedGenotypes();
+      is_packed = false;
+   }
+   if (is_packed){
+      if (i >= packed_variants.size())
+         packed_variants.resize(this->size());
+      packed_variants.set(i, v);
+   }
+   else{
+      if (i >= wide_variants.size())
+         wide_variants.resize(this->size());
+      wide_variants.at(i) = v;
+   }
 }
 
 void Genotype::setVariant(GenomicLocation p, char v)
@@ -43,14 +88,49 @@ char Genotype::variant(const GenomicLocation & p)
 
 char Genotype::variant(size_t i)
 {
-   if(i >= variants.size())
+   if (matrix)
+      return matrix->variant(i, matrix_column);
+   if (is_packed)
+      return packed_variants.get(i);
+   if(i >= wide_variants.size())
       throw std::out_of_range("This is not a valid position.");
-   return (variants.at(i));
+   return (wide_variants.at(i));
 }
 
 const std::vector<char> Genotype::variantsAsVector()
 {
-   return variants;
+   if (matrix){
+      std::vector<char> calls;
+      matrix->patientCalls(matrix_column, calls);
+      return calls;
+   }
+   if (is_packed)
+      return packed_variants.unpack();
+   return wide_variants;
+}
+
+//Writes the calls at first to first + count - 1 to out without allocating.
+//Calls that were never set read as missing.
+void Genotype::variantRange(size_t first, size_t count, char* out)
+{
+   if (first + count > this->size())
+      throw std::out_of_range("This is not a valid range.");
+   size_t stored;
+   if (matrix)
+      stored = matrix->variantCount();
+   else
+      stored = is_packed ? packed_variants.size() : wide_variants.size();
+   size_t n = (first >= stored) ? 0 : std::min(count, stored - first);
+   if (n > 0){
+      if (matrix)
+         matrix->patientCalls(matrix_column, first, n, out);
+      else if (is_packed)
+         packed_variants.unpack(first, n, out);
+      else
+         std::copy(wide_variants.begin() + first, 
+               wide_variants.begin() + first + n, out);
+   }
+   std::fill(out + n, out + count, (char) MissingVariant);
 }
 
 Population* Genotype::population()
@@ -5,6 +5,8 @@
 #include <memory>
 #include "Population.h"
 #include "GenotypeSchema.h"
+#include "PackedGenotypes.h"
+#include "GenotypeMatrix.h"
 
 namespace cge{
    namespace patients{
@@ -13,13 +15,21 @@ class Genotype
 {
 private: 
    std::shared_ptr<GenotypeSchema> genotype_schema;
-   std::vector<char> variants;
+   //variants are kept at 2 bits each until one without a 2 bit code is set,
+   //then they are widened to one char each
+   PackedGenotypes packed_variants;
+   std::vector<char> wide_variants;
+   bool is_packed;
+   //when set, the variants are column matrix_column of a cohort matrix
+   std::shared_ptr<GenotypeMatrix> matrix;
+   size_t matrix_column;
    Population* pop;
+   void detachFromMatrix();
 public:
-   Genotype()
-   {
-      variants.reserve(1);
-   }
+   static const char MissingVariant = -1;
+
+   Genotype() : is_packed(true), matrix_column(0), pop(nullptr) { }
+   Genotype(std::shared_ptr<GenotypeMatrix> M, size_t column);
    std::shared_ptr<GenotypeSchema> schema();
    void setSchema(std::shared_ptr<GenotypeSchema> S);
    size_t size();
@@ -28,6 +38,12 @@ public:
    char variant(const GenomicLocation & p);
    char variant(size_t i);
    const std::vector<char> variantsAsVector();
+   void variantRange(size_t first, size_t count, char* out);
+   bool isPacked() const {return is_packed;}
+   const PackedGenotypes& packedVariants() const {return packed_variants;}
+   bool isMatrixView() const {return matrix.get() != nullptr;}
+   std::shared_ptr<GenotypeMatrix> genotypeMatrix() const {return matrix;}
+   size_t matrixColumn() const {return matrix_column;}
    Population* population();
    void setPopulation(Population* p);
 };
@@ -0,0 +1,160 @@
+#include "GenotypeMatrix.h"
+#include <algorithm>
+
+namespace cge{
+   namespace patients{
+
+GenotypeMatrix::GenotypeMatrix(std::shared_ptr<GenotypeSchema> S, 
+      size_t patients) : 
+   matrix_schema(S), n_patients(patients), n_variants(0)
+{
+   stripe_words = (n_patients + PackedGenotypes::calls_per_word - 1) / 
+      PackedGenotypes::calls_per_word;
+   growToSchema();
+}
+
+void GenotypeMatrix::checkPosition(size_t v, size_t p) const
+{
+   if (v >= n_variants || p >= n_patients)
+      throw std::out_of_range("This is not a valid position.");
+}
+
+std::shared_ptr<GenotypeSchema> GenotypeMatrix::schema() const
+{
+   return matrix_schema;
+}
+
+size_t GenotypeMatrix::patientCount() const
+{
+   return n_patients;
+}
+
+size_t GenotypeMatrix::variantCount() const
+{
+   return n_variants;
+}
+
+//Adds hom-ref stripes for fields appended to the schema since the last call.
+void GenotypeMatrix::growToSchema()
+{
+   if (matrix_schema->size() > n_variants){
+      n_variants = matrix_schema->size();
+      calls.resize(n_variants * stripe_words, 0);
+   }
+}
+
+char GenotypeMatrix::variant(size_t v, size_t p) const
+{
+   checkPosition(v, p);
+   return PackedGenotypes::toChar(
+         PackedGenotypes::code(stripe(v), p));
+}
+
+void GenotypeMatrix::setVariant(size_t v, size_t p, char value)
+{
+   if (v >= n_variants)
+      growToSchema();
+   checkPosition(v, p);
+   if (!PackedGenotypes::fits(value))
+      throw std::invalid_argument("Value has no 2 bit genotype code");
+   PackedGenotypes::setCode(calls.data() + v * stripe_words, p, 
+         PackedGenotypes::toCode(value));
+}
+
+//The stripeWords() words holding the calls of every patient at variant v.
+const uint64_t* GenotypeMatrix::stripe(size_t v) const
+{
+   if (v >= n_variants)
+      throw std::out_of_range("This is not a valid position.");
+   return calls.data() + v * stripe_words;
+}
+
+size_t GenotypeMatrix::stripeWords() const
+{
+   return stripe_words;
+}
+
+//Number of patients whose call at variant v has the given code.
+size_t GenotypeMatrix::count(size_t v, uint8_t code) const
+{
+   return PackedGenotypes::count(stripe(v), n_patients, code);
+}
+
+//Fraction of called alleles at variant v that are not the reference.
+double GenotypeMatrix::alternateAlleleFrequency(size_t v) const
+{
+   size_t het = count(v, PackedGenotypes::Het);
+   size_t hom_alt = count(v, PackedGenotypes::HomAlt);
+   size_t called = n_patients - count(v, PackedGenotypes::Missing);
+   if (called == 0)
+      return 0;
+   return (het + 2.0 * hom_alt) / (2.0 * called);
+}
+
+void GenotypeMatrix::variantCalls(size_t v, std::vector<char>& out) const
+{
+   out.resize(n_patients);
+   if (n_patients > 0)
+      PackedGenotypes::unpack(stripe(v), 0, n_patients, out.data());
+}
+
+void GenotypeMatrix::patientCalls(size_t p, std::vector<char>& out) const
+{
+   if (p >= n_patients)
+      throw std::out_of_range("This is not a valid position.");
+   out.resize(n_variants);
+   for (size_t v = 0; v < n_variants; ++v)
+      out[v] = PackedGenotypes::toChar(
+            PackedGenotypes::code(calls.data() + v * stripe_words, p));
+}
+
+//Sets bit p of out if patient p's call at variant v is one of values. 
+//Values without a 2 bit code never match.
+void GenotypeMatrix::matchCalls(size_t v, const std::vector<char>& values, 
+      std::vector<uint64_t>& out) const
+{
+   uint8_t codes = 0;
+   for (auto c = values.begin(); c != values.end(); ++c){
+      if (PackedGenotypes::fits(*c))
+         codes |= 1 << PackedGenotypes::toCode(*c);
+   }
+   out.assign((n_patients + 63) / 64, 0);
+   if (n_patients > 0)
+      PackedGenotypes::match(stripe(v), n_patients, codes, out.data());
+}
+
+//Writes patient p's calls at variants first to first + count - 1 to out.
+void GenotypeMatrix::patientCalls(size_t p, size_t first, size_t count, 
+      char* out) const
+{
+   if (p >= n_patients || first + count > n_variants)
+      throw std::out_of_range("This is not a valid range.");
+   for (size_t v = first; v < first + count; ++v)
+      *out++ = PackedGenotypes::toChar(
+            PackedGenotypes::code(calls.data() + v * stripe_words, p));
+}
+
+//Fills the matrix from the per-sample calls stored in the schema's fields
+//(as read from a VCF), patient p taking sample p. A call becomes the number
+//of its alleles that are not the reference; calls with a missing allele
+//become missing.
+void GenotypeMatrix::setFromSampleGenotypes()
+{
+   growToSchema();
+   for (size_t v = 0; v < n_variants; ++v){
+      const std::vector<GenotypeCode>& codes = 
+         matrix_schema->field(v)->sampleGenotypes();
+      uint64_t* s = calls.data() + v * stripe_words;
+      size_t n = std::min(codes.size(), n_patients);
+      for (size_t p = 0; p < n; ++p){
+         std::pair<int,int> gt = VariantField::decodeGenotype(codes[p]);
+         uint8_t code = PackedGenotypes::Missing;
+         if (gt.first >= 0 && gt.second >= 0)
+            code = (gt.first > 0) + (gt.second > 0);
+         PackedGenotypes::setCode(s, p, code);
+      }
+   }
+}
+
+}//namespace patients
+}//namespace cge
@@ -0,0 +1,47 @@
+#ifndef GENOTYPEMATRIX_H
+#define GENOTYPEMATRIX_H
+
+#include <memory>
+#include <stdexcept>
+#include "GenotypeSchema.h"
+#include "PackedGenotypes.h"
+
+namespace cge{
+   namespace patients{
+
+//The genotypes of a whole cohort, one 2 bit call (see PackedGenotypes) per
+//variant and patient. Storage is variant-major: the calls of every patient
+//at one variant form a contiguous stripe of words, so per-variant scans 
+//read a single run of memory.
+class GenotypeMatrix
+{
+private:
+   std::shared_ptr<GenotypeSchema> matrix_schema;
+   size_t n_patients;
+   size_t n_variants;
+   size_t stripe_words;
+   std::vector<uint64_t> calls;
+   void checkPosition(size_t v, size_t p) const;
+public:
+   GenotypeMatrix(std::shared_ptr<GenotypeSchema> S, size_t patients);
+   std::shared_ptr<GenotypeSchema> schema() const;
+   size_t patientCount() const;
+   size_t variantCount() const;
+   void growToSchema();
+   char variant(size_t v, size_t p) const;
+   void setVariant(size_t v, size_t p, char value);
+   const uint64_t* stripe(size_t v) const;
+   size_t stripeWords() const;
+   size_t count(size_t v, uint8_t code) const;
+   double alternateAlleleFrequency(size_t v) const;
+   void variantCalls(size_t v, std::vector<char>& out) const;
+   void patientCalls(size_t p, std::vector<char>& out) const;
+   void patientCalls(size_t p, size_t first, size_t count, char* out) const;
+   void matchCalls(size_t v, const std::vector<char>& values, 
+         std::vector<uint64_t>& out) const;
+   void setFromSampleGenotypes();
+};
+
+}//namespace patients
+}//namespace cge
+#endif
@@ -1,15 +1,160 @@
 #ifndef GENOTYPESCHEMA_H
 #define GENOTYPESCHEMA_H
 
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <atomic>
 #include "FieldSchema.h"
 #include "VariantField.h"
+#include "GenomicRegion.h"
+#include "DbSNPIndex.h"
 
 namespace cge{
    namespace patients{
-   
+
+//(reference genome name, chromosome, position) of a GenomicLocation
+struct LocationKey
+{
+   std::string ref_name;
+   int chrom;
+   int pos;
+
+   LocationKey(const GenomicLocation& p) :
+      ref_name(p.refGenome() != nullptr ? p.refGenome()->name() : ""),
+      chrom(p.chromosome()), pos(p.position())
+   { }
+};
+inline bool operator==(const LocationKey& lhs, const LocationKey& rhs)
+{
+   return lhs.chrom == rhs.chrom && lhs.pos == rhs.pos &&
+      lhs.ref_name.compare(rhs.ref_name) == 0;
+}
+
+struct LocationKeyHash
+{
+   size_t operator()(const LocationKey& k) const
+   {
+      uint64_t coords = ((uint64_t)(uint32_t)k.chrom << 32) | (uint32_t)k.pos;
+      return std::hash<uint64_t>()(coords) ^
+         (std::hash<std::string>()(k.ref_name) << 1);
+   }
+};
+
 class GenotypeSchema : public FieldSchema<VariantField>
 {
-public: 
+private:
+   //positions of the fields at each location and with each rs number, in
+   //increasing order
+   std::unordered_map<LocationKey, std::vector<size_t>, LocationKeyHash>
+      location_index;
+   std::unordered_map<std::string, std::vector<size_t>> rs_index;
+   //(position, field position) pairs of each chromosome sorted by position,
+   //built on the first region query after the schema changes. Queries on a
+   //const schema may run concurrently, so the build is done under a lock.
+   typedef std::vector<std::pair<int,size_t>> PositionList;
+   mutable std::unordered_map<int, PositionList> region_index;
+   mutable std::atomic<bool> region_index_stale{true};
+   mutable std::mutex region_index_lock;
+
+   void buildRegionIndex() const
+   {
+      std::lock_guard<std::mutex> guard(region_index_lock);
+      if (!region_index_stale)
+         return;
+      region_index.clear();
+      for (size_t i = 0; i < size(); ++i){
+         if (storedField(i) != NULL){
+            GenomicLocation p = storedField(i)->location();
+            region_index[p.chromosome()].push_back(
+                  std::make_pair(p.position(), i));
+         }
+      }
+      for (auto it = region_index.begin(); it != region_index.end(); ++it)
+         std::sort(it->second.begin(), it->second.end());
+      region_index_stale = false;
+   }
+
+   //Appends the visible fields of r to result in position order.
+   void appendFieldsInRegion(const GenomicRegion& r, 
+         std::vector<size_t>& result) const
+   {
+      auto chrom = region_index.find(r.chrom);
+      if (chrom == region_index.end())
+         return;
+      const PositionList& positions = chrom->second;
+      auto it = std::lower_bound(positions.begin(), positions.end(),
+            std::make_pair(r.first, (size_t)0));
+      for (; it != positions.end() && it->first <= r.last; ++it){
+         if (isVisible(it->second))
+            result.push_back(it->second);
+      }
+   }
+
+   static bool hasRSNumber(const GenomicLocation& p)
+   {
+      return p.rsNumber().size() > 2;
+   }
+
+   static void insertSorted(std::vector<size_t>& positions, size_t i)
+   {
+      positions.insert(std::lower_bound(positions.begin(), positions.end(), i),
+            i);
+   }
+
+   static void eraseSorted(std::vector<size_t>& positions, size_t i)
+   {
+      auto it = std::lower_bound(positions.begin(), positions.end(), i);
+      if (it != positions.end() && *it == i)
+         positions.erase(it);
+   }
+
+   void unindexRS(size_t i, const std::string& rs)
+   {
+      auto found = rs_index.find(rs);
+      if (found != rs_index.end()){
+         eraseSorted(found->second, i);
+         if (found->second.empty())
+            rs_index.erase(found);
+      }
+   }
+
+   size_t firstVisible(const std::vector<size_t>& positions) const
+   {
+      for (auto it = positions.begin(); it != positions.end(); ++it){
+         if (isVisible(*it))
+            return *it;
+      }
+      return NonExistantField;
+   }
+protected:
+   void fieldIndexed(size_t i)
+   {
+      region_index_stale = true;
+      GenomicLocation p = storedField(i)->location();
+      insertSorted(location_index[LocationKey(p)], i);
+      if (hasRSNumber(p))
+         insertSorted(rs_index[p.rsNumber()], i);
+   }
+
+   void fieldUnindexed(size_t i)
+   {
+      region_index_stale = true;
+      GenomicLocation p = storedField(i)->location();
+      auto loc = location_index.find(LocationKey(p));
+      if (loc != location_index.end()){
+         eraseSorted(loc->second, i);
+         if (loc->second.empty())
+            location_index.erase(loc);
+      }
+      unindexRS(i, p.rsNumber());
+   }
+
+   void fieldsReserved(size_t n)
+   {
+      location_index.reserve(n);
+   }
+public:
    //Theres are rewritten since GenotypeScema declares a new field function.
    const VariantField* field(size_t i) const
    {
@@ -19,12 +164,22 @@ public:
    {
       return FieldSchema<VariantField>::field(name);
    }
-   
+
+   //Position of the first field at the same reference, chromosome and
+   //position as p or, failing that, with the same rs number as p. Lookups
+   //are hashed and never consult snp138.txt.
    size_t indexOfLocation(const GenomicLocation& p) const
    {
-      for(size_t i = 0; i < size(); ++i){
-      if ((field(i) != NULL) && ((field(i)->location()) == p))
-         return i;
+      auto loc = location_index.find(LocationKey(p));
+      if (loc != location_index.end()){
+         size_t i = firstVisible(loc->second);
+         if (i != NonExistantField)
+            return i;
+      }
+      if (hasRSNumber(p)){
+         auto rs = rs_index.find(p.rsNumber());
+         if (rs != rs_index.end())
+            return firstVisible(rs->second);
       }
       return NonExistantField;
    }
@@ -32,7 +187,99 @@ public:
    {
       return field(indexOfLocation(p));
    }
- 
+
+   //Sets the rs number of the field at i.
+   void setRSNumber(size_t i, const std::string& rs)
+   {
+      if (i >= size())
+         throw std::out_of_range("This field does not exist in the schema.");
+      VariantField* f = begin()[i];
+      if (f == NULL)
+         throw std::invalid_argument("This field is NULL");
+      GenomicLocation p = f->location();
+      unindexRS(i, p.rsNumber());
+      p.setRSNumber(rs);
+      f->setLocation(p);
+      if (hasRSNumber(p))
+         insertSorted(rs_index[rs], i);
+   }
+
+   //Sets the rs number of every field found in dbsnp, in one merge of the
+   //fields (in location order) with dbsnp's sorted records. Fields on a
+   //reference other than dbsnp's are skipped, and fields that already have
+   //an rs number are kept unless overwrite is set. Returns the number of 
+   //fields annotated.
+   size_t annotateRSNumbers(const DbSNPIndex& dbsnp, bool overwrite = false)
+   {
+      if (region_index_stale)
+         buildRegionIndex();
+      std::vector<int> chroms;
+      for (auto it = region_index.begin(); it != region_index.end(); ++it)
+         chroms.push_back(it->first);
+      std::sort(chroms.begin(), chroms.end());
+      size_t annotated = 0;
+      const DbSNPRecord* r = dbsnp.begin();
+      for (auto c = chroms.begin(); c != chroms.end(); ++c){
+         while (r != dbsnp.end() && r->chrom < *c)
+            ++r;
+         const PositionList& positions = region_index[*c];
+         for (auto it = positions.begin(); it != positions.end(); ++it){
+            if (it->first < 0)
+               continue;
+            while (r != dbsnp.end() && r->chrom == *c && 
+                  r->pos < (uint32_t)it->first)
+               ++r;
+            if (r == dbsnp.end() || r->chrom != *c)
+               break;
+            if (r->pos != (uint32_t)it->first)
+               continue;
+            const GenomicLocation& l = storedField(it->second)->location();
+            if (l.refGenome() == nullptr || 
+                  l.refGenome()->name() != dbsnp.reference())
+               continue;
+            if (!overwrite && hasRSNumber(l))
+               continue;
+            setRSNumber(it->second, "rs" + std::to_string(r->rs_id));
+            ++annotated;
+         }
+      }
+      return annotated;
+   }
+
+   //Positions of the fields lying in r, in position order. The first query
+   //after the schema changes sorts the fields by location, later ones take
+   //O(log n + matches).
+   std::vector<size_t> fieldsInRegion(const GenomicRegion& r) const
+   {
+      std::vector<size_t> result;
+      if (region_index_stale)
+         buildRegionIndex();
+      appendFieldsInRegion(r, result);
+      return result;
+   }
+
+   //Positions of the fields lying in any of regions, each reported once,
+   //ordered by chromosome and position.
+   std::vector<size_t> fieldsInRegions(std::vector<GenomicRegion> regions) const
+   {
+      std::vector<size_t> result;
+      if (region_index_stale)
+         buildRegionIndex();
+      //merges overlapping regions so no field is reported twice
+      std::sort(regions.begin(), regions.end());
+      std::vector<GenomicRegion> merged;
+      for (auto it = regions.begin(); it != regions.end(); ++it){
+         if (!merged.empty() && merged.back().chrom == it->chrom &&
+               it->first <= merged.back().last)
+            merged.back().last = std::max(merged.back().last, it->last);
+         else
+            merged.push_back(*it);
+      }
+      for (auto it = merged.begin(); it != merged.end(); ++it)
+         appendFieldsInRegion(*it, result);
+      return result;
+   }
+
 };
 
 }//namespace patients
@@ -0,0 +1,375 @@
+#include "Liftover.h"
+#include "StringFunctions.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <cctype>
+
+namespace cge{
+   namespace patients{
+
+namespace{
+
+//Chromosome number of a chain file sequence name such as "chr12", or -1.
+int chromosomeNumber(const std::string& name)
+{
+   utility::StringRef s(name.data(), name.size());
+   if (s.size > 3 && name.compare(0, 3, "chr") == 0)
+      s = utility::StringRef(s.data + 3, s.size - 3);
+   if (s.empty())
+      return -1;
+   for (size_t i = 0; i < s.size; ++i){
+      if (s[i] < '0' || s[i] > '9')
+         return -1;
+   }
+   return (int)utility::toInteger(s);
+}
+
+char complement(char base)
+{
+   switch (base){
+      case 'A': return 'T';
+      case 'C': return 'G';
+      case 'G': return 'C';
+      case 'T': return 'A';
+      case 'a': return 't';
+      case 'c': return 'g';
+      case 'g': return 'c';
+      case 't': return 'a';
+      default: return base;
+   }
+}
+
+//True for alleles such as <DEL> and * that are not bases.
+bool isSymbolic(const std::string& allele)
+{
+   return allele.empty() || allele[0] == '<' || allele == "*";
+}
+
+//Reverse complement of a sequence allele; symbolic alleles are returned 
+//unchanged.
+std::string reverseComplement(const std::string& allele)
+{
+   if (isSymbolic(allele))
+      return allele;
+   std::string rc(allele.rbegin(), allele.rend());
+   std::transform(rc.begin(), rc.end(), rc.begin(), complement);
+   return rc;
+}
+
+//True for a VCF style indel: sequence alleles of different lengths that 
+//share their first base.
+bool isAnchoredIndel(const std::vector<std::string>& alleles)
+{
+   if (alleles.size() < 2)
+      return false;
+   bool lengths_differ = false;
+   for (auto a = alleles.begin(); a != alleles.end(); ++a){
+      if (isSymbolic(*a) || 
+            std::toupper((unsigned char)(*a)[0]) != 
+            std::toupper((unsigned char)alleles[0][0]))
+         return false;
+      lengths_differ |= (a->size() != alleles[0].size());
+   }
+   return lengths_differ;
+}
+
+//allele as written on the target: reverse complemented for a - strand 
+//block and, if anchor is set, moved from its last base to anchor.
+std::string targetAllele(const std::string& allele, bool reverse, 
+      char anchor)
+{
+   if (!reverse || isSymbolic(allele))
+      return allele;
+   std::string rc = reverseComplement(allele);
+   if (anchor == 0)
+      return rc;
+   return anchor + rc.substr(0, rc.size() - 1);
+}
+
+std::string upperCase(std::string s)
+{
+   for (auto c = s.begin(); c != s.end(); ++c)
+      *c = (char)std::toupper((unsigned char)*c);
+   return s;
+}
+
+//The name VCF readers give a field without an rs number.
+std::string locationName(const GenomicLocation& l)
+{
+   return std::to_string(l.chromosome()) + "." + std::to_string(l.position());
+}
+
+}
+
+Liftover::Liftover(std::istream& chain, ReferenceGenome& target) :
+   target_genome(&target), n_blocks(0)
+{
+   load(chain);
+}
+
+Liftover::Liftover(const std::string& chain_path, ReferenceGenome& target) :
+   target_genome(&target), n_blocks(0)
+{
+   std::ifstream chain(chain_path.c_str());
+   if (!chain)
+      throw std::runtime_error("Could not open " + chain_path);
+   load(chain);
+}
+
+void Liftover::load(std::istream& chain)
+{
+   std::string line;
+   std::vector<utility::StringRef> cols;
+   //state of the chain being read
+   bool in_chain = false;
+   Chromosome* source = nullptr;
+   Block block;
+   uint32_t source_pos = 0;
+   uint32_t target_pos = 0;
+   while (std::getline(chain, line)){
+      if (!line.empty() && line.back() == '\r')
+         line.pop_back();
+      if (line.empty() || line[0] == '#'){
+         in_chain = false;
+         continue;
+      }
+      if (line.compare(0, 6, "chain ") == 0){
+         //chain score tName tSize tStrand tStart tEnd 
+         //      qName qSize qStrand qStart qEnd id
+         std::istringstream header(line);
+         std::string word, t_name, t_strand, q_name, q_strand;
+         int64_t score, t_size, t_start, t_end, q_size, q_start, q_end;
+         header >> word >> score >> t_name >> t_size >> t_strand >> t_start 
+            >> t_end >> q_name >> q_size >> q_strand >> q_start >> q_end;
+         if (!header || t_strand != "+")
+            throw std::invalid_argument("Malformed chain header: " + line);
+         int t_chrom = chromosomeNumber(t_name);
+         int q_chrom = chromosomeNumber(q_name);
+         in_chain = true;
+         source = (t_chrom < 0 || q_chrom < 0) ? nullptr : 
+            &chromosomes[t_chrom];
+         block.target_chrom = q_chrom;
+         block.target_size = (uint32_t)q_size;
+         block.reverse = (q_strand == "-");
+         block.score = score;
+         source_pos = (uint32_t)t_start;
+         target_pos = (uint32_t)q_start;
+         continue;
+      }
+      if (!in_chain)
+         throw std::invalid_argument("Alignment line outside a chain: " + line);
+      //size [dt dq]: an aligned block then the gaps before the next one
+      cols.clear();
+      for (size_t i = 0, start = 0; i <= line.size(); ++i){
+         if (i == line.size() || line[i] == '\t' || line[i] == ' '){
+            if (i > start)
+               cols.push_back(utility::StringRef(line.data() + start, 
+                        i - start));
+            start = i + 1;
+         }
+      }
+      if (cols.size() != 1 && cols.size() != 3)
+         throw std::invalid_argument("Malformed chain alignment: " + line);
+      uint32_t size = (uint32_t)utility::toInteger(cols[0]);
+      if (source != nullptr && size > 0){
+         block.source_start = source_pos;
+         block.source_end = source_pos + size;
+         block.target_start = target_pos;
+         source->blocks.push_back(block);
+         ++n_blocks;
+      }
+      source_pos += size;
+      target_pos += size;
+      if (cols.size() == 3){
+         source_pos += (uint32_t)utility::toInteger(cols[1]);
+         target_pos += (uint32_t)utility::toInteger(cols[2]);
+      }
+      else
+         in_chain = false;
+   }
+   for (auto c = chromosomes.begin(); c != chromosomes.end(); ++c){
+      std::vector<Block>& blocks = c->second.blocks;
+      std::sort(blocks.begin(), blocks.end(), 
+         [](const Block& a, const Block& b) 
+         {return a.source_start < b.source_start;});
+      c->second.max_end.resize(blocks.size());
+      uint32_t max_end = 0;
+      for (size_t i = 0; i < blocks.size(); ++i){
+         max_end = std::max(max_end, blocks[i].source_end);
+         c->second.max_end[i] = max_end;
+      }
+   }
+}
+
+//The highest scoring block holding the 0-based positions first to last,
+//inclusive, or nullptr.
+const Liftover::Block* Liftover::findBlock(int chrom, uint32_t first, 
+      uint32_t last) const
+{
+   auto c = chromosomes.find(chrom);
+   if (c == chromosomes.end())
+      return nullptr;
+   const std::vector<Block>& blocks = c->second.blocks;
+   const std::vector<uint32_t>& max_end = c->second.max_end;
+   //the last block starting at or before first
+   size_t i = std::upper_bound(blocks.begin(), blocks.end(), first,
+      [](uint32_t p, const Block& b) {return p < b.source_start;}) - 
+      blocks.begin();
+   const Block* best = nullptr;
+   //walks back while earlier blocks may still reach last
+   while (i > 0 && max_end[i - 1] > last){
+      --i;
+      if (blocks[i].source_end > last && 
+            (best == nullptr || blocks[i].score > best->score))
+         best = &blocks[i];
+   }
+   return best;
+}
+
+bool Liftover::lift(const GenomicLocation& from, GenomicLocation& lifted,
+      bool* reverse, uint32_t length) const
+{
+   if (from.position() < 1 || length < 1)
+      return false;
+   uint32_t pos = (uint32_t)from.position() - 1;
+   uint32_t last = pos + (length - 1);
+   if (last < pos)
+      return false;
+   const Block* b = findBlock(from.chromosome(), pos, last);
+   if (b == nullptr)
+      return false;
+   uint32_t target;
+   //- strand target coordinates count from the end of the chromosome, so
+   //the site's last base becomes its first
+   if (b->reverse)
+      target = b->target_size - 1 - 
+         (b->target_start + (last - b->source_start));
+   else
+      target = b->target_start + (pos - b->source_start);
+   lifted = GenomicLocation(b->target_chrom, target + 1, *target_genome);
+   lifted.setRSNumber(from.rsNumber());
+   if (reverse != nullptr)
+      *reverse = b->reverse;
+   return true;
+}
+
+void Liftover::setTargetSequence(
+      std::shared_ptr<const ReferenceSequence> sequence)
+{
+   if (sequence && sequence->reference().name() != target_genome->name())
+      throw std::invalid_argument(
+            "Sequence is not of the liftover's target reference");
+   target_sequence = sequence;
+}
+
+LiftoverResult Liftover::liftSchema(GenotypeSchema& schema, 
+      unsigned n_threads) const
+{
+   const std::vector<VariantField*> fields(schema.begin(), schema.end());
+   if (n_threads == 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+   n_threads = (unsigned)std::min<size_t>(n_threads, 
+         std::max<size_t>(1, fields.size()));
+   //the lookups only read the blocks and the sequence, so threads share 
+   //them unlocked
+   std::vector<GenomicLocation> lifted(fields.size());
+   std::vector<char> status(fields.size());   //0 unmapped, 1 +, 2 -
+   //the target base an indel on a - strand block is anchored on, or 0
+   std::vector<char> anchors(fields.size());
+   std::vector<char> mismatched(fields.size());
+   auto liftRange = [&](size_t first, size_t last)
+   {
+      for (size_t i = first; i < last; ++i){
+         if (fields[i] == NULL)
+            continue;
+         const std::vector<std::string>& alleles = fields[i]->alleles();
+         uint32_t length = alleles.empty() ? 1 : 
+            (uint32_t)std::max<size_t>(1, alleles[0].size());
+         bool reverse = false;
+         if (!lift(fields[i]->location(), lifted[i], &reverse, length))
+            continue;
+         if (reverse && isAnchoredIndel(alleles)){
+            //the anchor base now ends the site; VCF wants the base before it
+            std::string base;
+            if (target_sequence)
+               base = target_sequence->sequence(lifted[i].chromosome(),
+                     lifted[i].position() - 1, 1);
+            if (base.empty())
+               continue;
+            anchors[i] = base[0];
+            GenomicLocation anchored(lifted[i].chromosome(), 
+                  lifted[i].position() - 1, *target_genome);
+            anchored.setRSNumber(lifted[i].rsNumber());
+            lifted[i] = anchored;
+         }
+         status[i] = reverse ? 2 : 1;
+         if (target_sequence && !alleles.empty() && 
+               !isSymbolic(alleles[0])){
+            std::string ref = targetAllele(alleles[0], reverse, anchors[i]);
+            mismatched[i] = target_sequence->sequence(lifted[i].chromosome(),
+                  lifted[i].position(), ref.size()) != upperCase(ref);
+         }
+      }
+   };
+   std::vector<std::thread> workers;
+   size_t per_thread = (fields.size() + n_threads - 1) / n_threads;
+   for (unsigned t = 1; t < n_threads; ++t){
+      size_t first = std::min(fields.size(), t * per_thread);
+      size_t last = std::min(fields.size(), first + per_thread);
+      workers.push_back(std::thread(liftRange, first, last));
+   }
+   liftRange(0, std::min(fields.size(), per_thread));
+   for (auto it = workers.begin(); it != workers.end(); ++it)
+      it->join();
+
+   LiftoverResult result;
+   std::vector<VariantField*> batch;
+   batch.reserve(fields.size());
+   //names taken in the new schema, so that a site landing where another 
+   //already did is reported rather than failing the whole batch
+   std::unordered_set<std::string> names;
+   for (size_t i = 0; i < fields.size(); ++i){
+      if (fields[i] == NULL)
+         continue;
+      if (status[i] == 0){
+         result.unmapped.push_back(i);
+         continue;
+      }
+      std::string name = fields[i]->name();
+      if (name == locationName(fields[i]->location()))
+         name = locationName(lifted[i]);
+      if (!names.insert(name).second){
+         result.unmapped.push_back(i);
+         continue;
+      }
+      VariantField* f = new VariantField(*fields[i]);
+      f->setName(name);
+      f->setLocation(lifted[i]);
+      if (status[i] == 2){
+         std::vector<std::string> alleles(f->alleles());
+         for (auto a = alleles.begin(); a != alleles.end(); ++a)
+            *a = targetAllele(*a, true, anchors[i]);
+         f->setAlleles(alleles);
+      }
+      if (mismatched[i])
+         result.ref_mismatch.push_back(i);
+      batch.push_back(f);
+   }
+   result.schema.reset(new GenotypeSchema());
+   try{
+      result.schema->appendFields(batch);
+   }
+   catch(...){
+      for (auto it = batch.begin(); it != batch.end(); ++it)
+         delete *it;
+      throw;
+   }
+   return result;
+}
+
+}//namespace patients
+}//namespace cge
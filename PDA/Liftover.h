@@ -0,0 +1,103 @@
+#ifndef LIFTOVER_H
+#define LIFTOVER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <unordered_map>
+#include <cstdint>
+#include "GenotypeSchema.h"
+#include "ReferenceSequence.h"
+
+namespace cge{
+   namespace patients{
+
+//A GenotypeSchema lifted to another reference. unmapped holds the positions,
+//in the source schema, of the fields with no place on the new reference;
+//ref_mismatch those of lifted fields whose reference allele differs from
+//the target sequence (see Liftover::setTargetSequence).
+struct LiftoverResult
+{
+   std::shared_ptr<GenotypeSchema> schema;
+   std::vector<size_t> unmapped;
+   std::vector<size_t> ref_mismatch;
+};
+
+//Maps locations from one reference to another using the aligned blocks of a
+//UCSC chain file (e.g. hg19ToHg38.over.chain). The blocks of each source
+//chromosome are kept sorted by start with a running maximum of their ends,
+//so a lookup is a binary search plus a scan over overlapping blocks.
+//Chromosomes without a number (chrX, alternate contigs, ...) are left out.
+class Liftover
+{
+private:
+   //an ungapped aligned block, 0-based half-open on the source
+   struct Block
+   {
+      uint32_t source_start;
+      uint32_t source_end;
+      uint32_t target_start;
+      uint32_t target_size;   //of the target chromosome, for - strand blocks
+      int32_t target_chrom;
+      bool reverse;
+      int64_t score;   //of the chain the block belongs to
+   };
+   struct Chromosome
+   {
+      std::vector<Block> blocks;
+      //max_end[i] is the largest source_end of blocks[0..i]
+      std::vector<uint32_t> max_end;
+   };
+   std::unordered_map<int, Chromosome> chromosomes;
+   ReferenceGenome* target_genome;
+   std::shared_ptr<const ReferenceSequence> target_sequence;
+   size_t n_blocks;
+
+   void load(std::istream& chain);
+   const Block* findBlock(int chrom, uint32_t first, uint32_t last) const;
+public:
+   //Reads a UCSC chain file mapping onto target. Throws 
+   //std::invalid_argument if it is malformed, std::runtime_error if it 
+   //cannot be opened.
+   Liftover(std::istream& chain, ReferenceGenome& target);
+   Liftover(const std::string& chain_path, ReferenceGenome& target);
+
+   ReferenceGenome& target() const {return *target_genome;}
+   size_t size() const {return n_blocks;}
+
+   //The bases of the target reference, used by liftSchema to anchor indels
+   //and check reference alleles. Throws std::invalid_argument if sequence
+   //is of another reference.
+   void setTargetSequence(std::shared_ptr<const ReferenceSequence> sequence);
+   std::shared_ptr<const ReferenceSequence> targetSequence() const
+   {
+      return target_sequence;
+   }
+
+   //Sets lifted to from's place on the target reference, keeping its rs
+   //number. length is the number of bases the site covers starting at from
+   //(the length of its reference allele); all of them must lie in one 
+   //aligned block. Where chains overlap, the highest scoring one is used. 
+   //Returns false, leaving lifted alone, if from does not map. reverse, if
+   //given, is set to whether from maps onto the opposite strand; the site 
+   //then starts at the target position of its last base.
+   bool lift(const GenomicLocation& from, GenomicLocation& lifted, 
+         bool* reverse = nullptr, uint32_t length = 1) const;
+
+   //Lifts every field of schema into a new schema on the target reference.
+   //The lifted fields are copies of the originals; alleles of fields mapped
+   //onto the opposite strand are reverse complemented, and fields named 
+   //"chrom.pos" after their location are renamed for the new one. A field
+   //whose name is already taken by an earlier lifted field is unmapped.
+   //Indels on the opposite strand are anchored on the target base before
+   //them, as VCF requires, so without a target sequence they are unmapped.
+   //With one, reference alleles are checked against it. The lookups are 
+   //split over n_threads threads (0 for one per core).
+   LiftoverResult liftSchema(GenotypeSchema& schema, 
+         unsigned n_threads = 0) const;
+};
+
+}//namespace patients
+}//namespace cge
+#endif
@@ -0,0 +1,82 @@
+#include "LocationCache.h"
+#include "DbSNPIndex.h"
+
+namespace cge{
+   namespace patients{
+
+LocationCache::LocationCache() : 
+   max_entries(DefaultCapacity), n_hits(0), n_misses(0)
+{ }
+
+LocationCache& LocationCache::Instance()
+{
+   static LocationCache singleton;
+   return singleton;
+}
+
+void LocationCache::evictToCapacity()
+{
+   while (entries.size() > max_entries){
+      entry_index.erase(entries.back().first);
+      entries.pop_back();
+   }
+}
+
+std::string LocationCache::resolveRS(const ReferenceGenome& ref, int chrom,
+      int pos)
+{
+   const DbSNPIndex* dbsnp = DbSNPIndex::Instance(ref);
+   if (dbsnp == nullptr)
+      return "";
+   Key key = makeKey(ref, chrom, pos);
+   {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      auto found = entry_index.find(key);
+      if (found != entry_index.end()){
+         entries.splice(entries.begin(), entries, found->second);
+         ++n_hits;
+         return found->second->second;
+      }
+   }
+   ++n_misses;
+   //the lookup is done unlocked so misses on other threads are not held up
+   std::string rs = dbsnp->lookup(chrom, pos);
+   std::lock_guard<std::mutex> lock(cache_mutex);
+   if (max_entries > 0 && entry_index.find(key) == entry_index.end()){
+      entries.push_front(std::make_pair(key, rs));
+      entry_index[key] = entries.begin();
+      evictToCapacity();
+   }
+   return rs;
+}
+
+size_t LocationCache::size() const
+{
+   std::lock_guard<std::mutex> lock(cache_mutex);
+   return entries.size();
+}
+
+size_t LocationCache::capacity() const
+{
+   std::lock_guard<std::mutex> lock(cache_mutex);
+   return max_entries;
+}
+
+void LocationCache::setCapacity(size_t n)
+{
+   std::lock_guard<std::mutex> lock(cache_mutex);
+   max_entries = n;
+   evictToCapacity();
+}
+
+void LocationCache::clear()
+{
+   std::lock_guard<std::mutex> lock(cache_mutex);
+   entries.clear();
+   entry_index.clear();
+   n_hits = 0;
+   n_misses = 0;
+}
+
+}//namespace patients
+}//namespace cge
@@ -0,0 +1,83 @@
+#ifndef LOCATIONCACHE_H
+#define LOCATIONCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "ReferenceGenome.h"
+
+namespace cge{
+   namespace patients{
+
+//Process-wide cache of the rs numbers resolved for (reference, chromosome,
+//position) triples, so that comparing locations on different references does one 
+//dbSNP lookup per location rather than one per comparison. Holds at most
+//capacity() entries, evicting the least recently used. Safe to share 
+//between threads.
+class LocationCache
+{
+private:
+   struct Key
+   {
+      std::string ref;
+      uint64_t location;
+      bool operator==(const Key& other) const
+      {
+         return location == other.location && ref == other.ref;
+      }
+   };
+   struct KeyHash
+   {
+      size_t operator()(const Key& k) const
+      {
+         return std::hash<uint64_t>()(k.location) ^ 
+            std::hash<std::string>()(k.ref);
+      }
+   };
+   typedef std::list<std::pair<Key, std::string>> EntryList;
+   //most recently used first
+   EntryList entries;
+   std::unordered_map<Key, EntryList::iterator, KeyHash> entry_index;
+   size_t max_entries;
+   mutable std::mutex cache_mutex;
+   std::atomic<size_t> n_hits;
+   std::atomic<size_t> n_misses;
+   LocationCache();
+   LocationCache(const LocationCache&);              //Prevent copy-construction
+   LocationCache& operator=(const LocationCache&);   //Prevent assignment
+
+   static Key makeKey(const ReferenceGenome& ref, int chrom, int pos)
+   {
+      Key k;
+      k.ref = ref.name();
+      k.location = ((uint64_t)(uint32_t)chrom << 32) | (uint32_t)pos;
+      return k;
+   }
+   void evictToCapacity();
+public:
+   static const size_t DefaultCapacity = 1 << 20;
+
+   static LocationCache& Instance();
+
+   //The rs number ("rs1234") at chrom and pos on ref, from the cache or, on
+   //a miss, DbSNPIndex::Instance(ref). Returns "" if there is none or ref
+   //has no dbSNP index.
+   std::string resolveRS(const ReferenceGenome& ref, int chrom, int pos);
+
+   size_t hits() const {return n_hits;}
+   size_t misses() const {return n_misses;}
+   size_t size() const;
+   size_t capacity() const;
+   //Evicts entries down to n if there are more.
+   void setCapacity(size_t n);
+   //Empties the cache and resets the counters.
+   void clear();
+};
+
+}//namespace patients
+}//namespace cge
+#endif
@@ -0,0 +1,182 @@
+#ifndef PACKEDGENOTYPES_H
+#define PACKEDGENOTYPES_H
+
+#include <vector>
+#include <bitset>
+#include <stdexcept>
+#include <cstdint>
+
+namespace cge{
+   namespace patients{
+
+//Stores calls at 2 bits each, 32 to a 64 bit word. The codes are the
+//allele dosages of a biallelic site plus missing: 0 hom-ref, 1 het,
+//2 hom-alt, 3 missing. As chars, missing is -1.
+class PackedGenotypes
+{
+private:
+   std::vector<uint64_t> words;
+   size_t n_calls;
+public:
+   static const uint8_t HomRef = 0;
+   static const uint8_t Het = 1;
+   static const uint8_t HomAlt = 2;
+   static const uint8_t Missing = 3;
+
+   static const int calls_per_word = 32;
+
+   PackedGenotypes() : n_calls(0) { }
+
+   static char toChar(uint64_t code)
+   {
+      return (code == Missing) ? -1 : (char)code;
+   }
+
+   //Writes the count calls of words starting at call first to out as chars,
+   //a word at a time.
+   static void unpack(const uint64_t* words, size_t first, size_t count, 
+         char* out)
+   {
+      size_t i = first;
+      size_t stop = first + count;
+      while (i < stop){
+         uint64_t w = words[i / calls_per_word] >> (2 * (i % calls_per_word));
+         size_t in_word = calls_per_word - i % calls_per_word;
+         if (in_word > stop - i)
+            in_word = stop - i;
+         for (size_t k = 0; k < in_word; ++k, w >>= 2)
+            *out++ = toChar(w & 3);
+         i += in_word;
+      }
+   }
+
+   //Number of the first n_calls calls of words with code c, counted a word
+   //at a time.
+   static size_t count(const uint64_t* words, size_t n_calls, uint8_t c)
+   {
+      const uint64_t low_bits = 0x5555555555555555ULL;
+      uint64_t pattern = low_bits * (c & 3);
+      size_t total = 0;
+      size_t n_words = (n_calls + calls_per_word - 1) / calls_per_word;
+      for (size_t w = 0; w < n_words; ++w){
+         uint64_t x = words[w] ^ pattern;
+         uint64_t match = ~(x | (x >> 1)) & low_bits;
+         //ignores the unused tail of the last word
+         size_t used = n_calls - w * calls_per_word;
+         if (used < calls_per_word)
+            match &= ((uint64_t)1 << (2 * used)) - 1;
+         total += std::bitset<64>(match).count();
+      }
+      return total;
+   }
+
+   //Sets bit i of out ((n_calls + 63) / 64 words) if the code of call i is
+   //in codes, a set of codes with code c as bit c. Each pair of words of 
+   //calls becomes one word of out.
+   static void match(const uint64_t* words, size_t n_calls, uint8_t codes, 
+         uint64_t* out)
+   {
+      const uint64_t low_bits = 0x5555555555555555ULL;
+      size_t n_words = (n_calls + calls_per_word - 1) / calls_per_word;
+      for (size_t w = 0; w < n_words; ++w){
+         uint64_t hits = 0;
+         for (uint8_t c = 0; c < 4; ++c){
+            if (!(codes >> c & 1))
+               continue;
+            uint64_t x = words[w] ^ (low_bits * c);
+            hits |= ~(x | (x >> 1)) & low_bits;
+         }
+         size_t used = n_calls - w * calls_per_word;
+         if (used < calls_per_word)
+            hits &= ((uint64_t)1 << (2 * used)) - 1;
+         //gathers the even bits into the low 32
+         hits = (hits | (hits >> 1)) & 0x3333333333333333ULL;
+         hits = (hits | (hits >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+         hits = (hits | (hits >> 4)) & 0x00ff00ff00ff00ffULL;
+         hits = (hits | (hits >> 8)) & 0x0000ffff0000ffffULL;
+         hits = (hits | (hits >> 16)) & 0x00000000ffffffffULL;
+         if (w % 2 == 0)
+            out[w / 2] = hits;
+         else
+            out[w / 2] |= hits << 32;
+      }
+   }
+
+   //True if v has a 2 bit code.
+   static bool fits(char v) {return v >= -1 && v <= 2;}
+
+   static uint8_t toCode(char v) {return (v < 0) ? Missing : (uint8_t)v;}
+
+   size_t size() const {return n_calls;}
+
+   //New calls are hom-ref.
+   void resize(size_t n)
+   {
+      words.resize((n + calls_per_word - 1) / calls_per_word, 0);
+      //clears calls past the end so they read back as hom-ref if regrown
+      if (n < n_calls && n % calls_per_word != 0)
+         words.back() &= (~(uint64_t)0) >> (2 * (calls_per_word -
+               n % calls_per_word));
+      n_calls = n;
+   }
+
+   static uint8_t code(const uint64_t* words, size_t i)
+   {
+      return (words[i / calls_per_word] >> (2 * (i % calls_per_word))) & 3;
+   }
+
+   static void setCode(uint64_t* words, size_t i, uint8_t c)
+   {
+      uint64_t& w = words[i / calls_per_word];
+      int shift = 2 * (i % calls_per_word);
+      w = (w & ~((uint64_t)3 << shift)) | ((uint64_t)(c & 3) << shift);
+   }
+
+   uint8_t code(size_t i) const {return code(words.data(), i);}
+
+   void setCode(size_t i, uint8_t c) {setCode(words.data(), i, c);}
+
+   char get(size_t i) const
+   {
+      if (i >= n_calls)
+         throw std::out_of_range("This is not a valid position.");
+      return toChar(code(i));
+   }
+
+   void set(size_t i, char v)
+   {
+      if (i >= n_calls)
+         throw std::out_of_range("This is not a valid position.");
+      if (!fits(v))
+         throw std::invalid_argument("Value has no 2 bit genotype code");
+      setCode(i, toCode(v));
+   }
+
+   //Writes the count calls starting at first to out as chars.
+   void unpack(size_t first, size_t count, char* out) const
+   {
+      if (first + count > n_calls)
+         throw std::out_of_range("This is not a valid range.");
+      unpack(words.data(), first, count, out);
+   }
+
+   std::vector<char> unpack() const
+   {
+      std::vector<char> out(n_calls);
+      if (n_calls > 0)
+         unpack(0, n_calls, out.data());
+      return out;
+   }
+
+   //Number of calls with code c.
+   size_t count(uint8_t c) const
+   {
+      return count(words.data(), n_calls, c);
+   }
+
+   const std::vector<uint64_t>& data() const {return words;}
+};
+
+}//namespace patients
+}//namespace cge
+#endif
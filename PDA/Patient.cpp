@@ -13,7 +13,7 @@ void Patient::setName(const std::string& n)
    patient_name = n;
 }
 
-std::shared_ptr<ClinicalRecord> Patient::clinicalRecord()
+std::shared_ptr<ClinicalRecord> Patient::clinicalRecord() const
 {
    return patient_clin_record;
 }
@@ -23,7 +23,7 @@ void Patient::setClinicalRecord(std::shared_ptr<ClinicalRecord> r)
    patient_clin_record = r;
 }
 
-std::shared_ptr<Genotype> Patient::genotype()
+std::shared_ptr<Genotype> Patient::genotype() const
 {
    return patient_genotype;
 }
@@ -71,5 +71,50 @@ PatientIterator Patient::end()
    return PatientIterator(this,size());
 }
 
+PatientCursor Patient::cursor() const
+{
+   return PatientCursor(*this);
+}
+
+PatientCursor::PatientCursor(const Patient& p) : 
+   record(p.patient_clin_record.get()), genotype(p.patient_genotype.get()),
+   n_clinical(0), n_variants(0), pos(0)
+{
+   if (record)
+      n_clinical = record->schema()->size();
+   if (genotype)
+      n_variants = genotype->size();
+}
+
+CompactValue PatientCursor::clinicalValue() const
+{
+   if (!isClinical())
+      throw std::out_of_range("The cursor is not on a clinical field.");
+   return record->value(pos);
+}
+
+char PatientCursor::variant() const
+{
+   if (!isVariant())
+      throw std::out_of_range("The cursor is not on a variant.");
+   char c;
+   genotype->variantRange(pos - n_clinical, 1, &c);
+   return c;
+}
+
+const ClinicalField* PatientCursor::clinicalField() const
+{
+   if (!isClinical())
+      throw std::out_of_range("The cursor is not on a clinical field.");
+   return record->schema()->field(pos);
+}
+
+const VariantField* PatientCursor::variantField() const
+{
+   if (!isVariant())
+      throw std::out_of_range("The cursor is not on a variant.");
+   return genotype->schema()->field(pos - n_clinical);
+}
+
 }//namespace patients
 }//namespace cge
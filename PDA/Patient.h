@@ -5,11 +5,13 @@
 #include "ClinicalRecord.h"
 #include "Value.h"
 #include "Field.h"
+#include <algorithm>
 
 namespace cge{
    namespace patients{
    
 class PatientIterator;
+class PatientCursor;
 
 class Patient
 {
@@ -20,17 +22,78 @@ private:
 public: 
    const std::string name();
    void setName(const std::string& n);
-   std::shared_ptr<ClinicalRecord> clinicalRecord();
+   std::shared_ptr<ClinicalRecord> clinicalRecord() const;
    void setClinicalRecord(std::shared_ptr<ClinicalRecord> r);
-   std::shared_ptr<Genotype> genotype();
+   std::shared_ptr<Genotype> genotype() const;
    void setGenotype(std::shared_ptr<Genotype> g);
    size_t size();
    Value value(size_t i) const;
    Field field(size_t i) const;
    PatientIterator begin();
    PatientIterator end();
+   PatientCursor cursor() const;
+   template <typename ClinicalVisitor, typename VariantVisitor>
+   void visit(ClinicalVisitor on_clinical, VariantVisitor on_variant) const;
+
+   friend class PatientCursor;
 };
 
+//Walks a patient's values without allocating: the clinical record's fields
+//come first, then the genotype's calls. A missing record or genotype is an
+//empty segment.
+class PatientCursor
+{
+private:
+   const ClinicalRecord* record;
+   Genotype* genotype;
+   size_t n_clinical;
+   size_t n_variants;
+   size_t pos;
+public:
+   PatientCursor(const Patient& p);
+   bool done() const {return pos >= n_clinical + n_variants;}
+   void next() {++pos;}
+   void seek(size_t i) {pos = i;}
+   //position as used by Patient::value and Patient::field
+   size_t position() const {return pos;}
+   bool isClinical() const {return pos < n_clinical;}
+   bool isVariant() const {return pos >= n_clinical && !done();}
+   //position within the clinical or the genotype schema
+   size_t fieldIndex() const {return isClinical() ? pos : pos - n_clinical;}
+   size_t clinicalSize() const {return n_clinical;}
+   size_t variantSize() const {return n_variants;}
+   CompactValue clinicalValue() const;
+   char variant() const;
+   const ClinicalField* clinicalField() const;
+   const VariantField* variantField() const;
+};
+
+//Calls on_clinical(i, CompactValue) for each clinical field and then 
+//on_variant(i, char) for each call, i being the position within the 
+//segment's schema. Calls are unpacked a block at a time into a buffer on the
+//stack.
+template <typename ClinicalVisitor, typename VariantVisitor>
+void Patient::visit(ClinicalVisitor on_clinical, VariantVisitor on_variant) 
+   const
+{
+   if (patient_clin_record){
+      size_t n = patient_clin_record->schema()->size();
+      for (size_t i = 0; i < n; ++i)
+         on_clinical(i, patient_clin_record->value(i));
+   }
+   if (patient_genotype){
+      const size_t Block = 256;
+      char calls[Block];
+      size_t n = patient_genotype->size();
+      for (size_t first = 0; first < n; first += Block){
+         size_t count = std::min(Block, n - first);
+         patient_genotype->variantRange(first, count, calls);
+         for (size_t k = 0; k < count; ++k)
+            on_variant(first + k, calls[k]);
+      }
+   }
+}
+
 class PatientIterator
 {
 private: 
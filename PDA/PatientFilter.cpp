@@ -0,0 +1,445 @@
+#include "PatientFilter.h"
+#include <algorithm>
+#include "Parallel.h"
+
+namespace cge{
+   namespace patients{
+
+class PatientFilter::Node
+{
+public:
+   virtual ~Node() { }
+   virtual void evaluate(FilterContext& C, std::vector<uint64_t>& out) const
+      = 0;
+   virtual bool matches(const Patient& P) const = 0;
+};
+
+//The set's table and matrix, and whether patient i is row (column) i of 
+//them, looked up once per evaluation.
+class FilterContext
+{
+public:
+   const PatientSet& patients;
+   unsigned n_threads;
+   size_t n_words;
+   std::shared_ptr<ClinicalTable> table;
+   bool table_aligned;
+   std::shared_ptr<GenotypeMatrix> matrix;
+   bool matrix_aligned;
+   std::vector<IndexUse>* index_uses;
+
+   FilterContext(const PatientSet& S, unsigned threads, 
+         std::vector<IndexUse>* used);
+   void gather(const std::vector<size_t>& rows, bool aligned,
+         const std::vector<uint64_t>* store_bits, 
+         const PatientFilter::Node& test, std::vector<uint64_t>& out);
+};
+
+FilterContext::FilterContext(const PatientSet& S, unsigned threads, 
+      std::vector<IndexUse>* used) :
+   patients(S), n_threads(threads), n_words((S.size() + 63) / 64),
+   table(S.clinicalTable()), table_aligned(S.clinicalTableAligned()), 
+   matrix(S.genotypeMatrix()), matrix_aligned(S.genotypeMatrixAligned()), 
+   index_uses(used)
+{ }
+
+//Sets bit i of out from bit rows[i] of store_bits, the result of a column
+//kernel over the table or matrix, for the patients that are views into it,
+//and by testing the rest one at a time. store_bits is null if the kernel
+//could not run.
+void FilterContext::gather(const std::vector<size_t>& rows, bool aligned,
+      const std::vector<uint64_t>* store_bits, 
+      const PatientFilter::Node& test, std::vector<uint64_t>& out)
+{
+   if (store_bits && aligned){
+      out = *store_bits;
+      return;
+   }
+   out.assign(n_words, 0);
+   const uint64_t* store = store_bits ? store_bits->data() : nullptr;
+   utility::parallelRanges(patients.size(), n_threads, 64,
+         [&](size_t first, size_t last)
+   {
+      //builds each word in a register; ranges start on word boundaries
+      for (size_t w_first = first; w_first < last; w_first += 64){
+         size_t count = std::min<size_t>(64, last - w_first);
+         uint64_t bits = 0;
+         for (size_t k = 0; k < count; ++k){
+            size_t r = store ? rows[w_first + k] : PatientSet::NoRow;
+            uint64_t b;
+            if (r != PatientSet::NoRow)
+               b = (store[r / 64] >> (r % 64)) & 1;
+            else
+               b = test.matches(*patients.begin()[w_first + k]);
+            bits |= b << k;
+         }
+         out[w_first / 64] = bits;
+      }
+   });
+}
+
+namespace{
+
+//A test on the value of one clinical field.
+class ClinicalTest : public PatientFilter::Node
+{
+protected:
+   std::string field;
+   //Sets bit row of out for the rows of c that pass.
+   virtual void columnKernel(const ClinicalColumn& c,
+         std::vector<uint64_t>& out) const = 0;
+   //As columnKernel, from c's index. Returns the index used, or None if 
+   //it wasn't.
+   virtual IndexKind indexLookup(const ClinicalColumn&, 
+         std::vector<uint64_t>&) const
+   {
+      return IndexKind::None;
+   }
+   virtual bool test(const CompactValue& v) const = 0;
+public:
+   ClinicalTest(const std::string& f) : field(f) { }
+
+   void evaluate(FilterContext& C, std::vector<uint64_t>& out) const
+   {
+      std::vector<uint64_t> rows;
+      if (C.table){
+         size_t f = C.table->schema()->indexOfField(field);
+         if (f != C.table->schema()->NonExistantField &&
+               f < C.table->fieldCount()){
+            const ClinicalColumn& c = C.table->column(f);
+            IndexKind used = IndexKind::None;
+            if (c.index())
+               used = indexLookup(c, rows);
+            if (used == IndexKind::None)
+               columnKernel(c, rows);
+            if (C.index_uses){
+               IndexUse u = {field, used};
+               C.index_uses->push_back(u);
+            }
+         }
+         else if (test(CompactValue())){
+            //every row lacks the field
+            size_t n = C.table->patientCount();
+            rows.assign((n + 63) / 64, ~(uint64_t)0);
+            if (n % 64 != 0)
+               rows.back() &= ((uint64_t)1 << (n % 64)) - 1;
+         }
+         else
+            rows.assign((C.table->patientCount() + 63) / 64, 0);
+      }
+      C.gather(C.patients.clinicalTableRows(), C.table_aligned, 
+            C.table ? &rows : nullptr, *this, out);
+   }
+
+   bool matches(const Patient& P) const
+   {
+      std::shared_ptr<ClinicalRecord> r = P.clinicalRecord();
+      if (!r || !r->schema())
+         return test(CompactValue());
+      size_t f = r->schema()->indexOfField(field);
+      if (f == r->schema()->NonExistantField)
+         return test(CompactValue());
+      return test(r->value(f));
+   }
+};
+
+class CompareTest : public ClinicalTest
+{
+private:
+   CompareOp op;
+   CompactValue constant;
+   //keeps a string constant alive
+   std::shared_ptr<StringValue> string_constant;
+protected:
+   void columnKernel(const ClinicalColumn& c, std::vector<uint64_t>& out)
+      const
+   {
+      c.compare(op, constant, out);
+   }
+   IndexKind indexLookup(const ClinicalColumn& c, std::vector<uint64_t>& out)
+      const
+   {
+      return c.index()->compare(c, op, constant, out);
+   }
+   bool test(const CompactValue& v) const
+   {
+      return compareValues(v, op, constant);
+   }
+public:
+   CompareTest(const std::string& f, CompareOp o, const CompactValue& v) :
+      ClinicalTest(f), op(o), constant(v)
+   { }
+   CompareTest(const std::string& f, CompareOp o, const std::string& s) :
+      ClinicalTest(f), op(o), string_constant(new StringValue(s))
+   {
+      constant = CompactValue(string_constant.get());
+   }
+};
+
+class DateTest : public ClinicalTest
+{
+private:
+   date::Days first;
+   date::Days last;
+protected:
+   void columnKernel(const ClinicalColumn& c, std::vector<uint64_t>& out)
+      const
+   {
+      c.dateRange(first, last, out);
+   }
+   IndexKind indexLookup(const ClinicalColumn& c, std::vector<uint64_t>& out)
+      const
+   {
+      return c.index()->dateRange(c, first, last, out);
+   }
+   bool test(const CompactValue& v) const
+   {
+      if (v.isMissing())
+         return false;
+      if (v.typeTag() != ClinicalType::Date)
+         throw std::invalid_argument("Field does not hold dates");
+      return v.days() >= first && v.days() <= last;
+   }
+public:
+   DateTest(const std::string& f, date::Days a, date::Days b) :
+      ClinicalTest(f), first(a), last(b)
+   { }
+};
+
+class MissingTest : public ClinicalTest
+{
+protected:
+   void columnKernel(const ClinicalColumn& c, std::vector<uint64_t>& out)
+      const
+   {
+      out = c.validityBitmap();
+      for (size_t w = 0; w < out.size(); ++w)
+         out[w] = ~out[w];
+      if (c.size() % 64 != 0)
+         out.back() &= ((uint64_t)1 << (c.size() % 64)) - 1;
+   }
+   bool test(const CompactValue& v) const
+   {
+      return v.isMissing();
+   }
+public:
+   MissingTest(const std::string& f) : ClinicalTest(f) { }
+};
+
+class GenotypeTest : public PatientFilter::Node
+{
+private:
+   GenomicLocation site;
+   std::vector<char> calls;
+public:
+   GenotypeTest(const GenomicLocation& s, const std::vector<char>& c) :
+      site(s), calls(c)
+   { }
+
+   void evaluate(FilterContext& C, std::vector<uint64_t>& out) const
+   {
+      std::vector<uint64_t> columns;
+      if (C.matrix){
+         size_t v = C.matrix->schema()->indexOfLocation(site);
+         if (v != C.matrix->schema()->NonExistantField &&
+               v < C.matrix->variantCount())
+            C.matrix->matchCalls(v, calls, columns);
+         else
+            columns.assign((C.matrix->patientCount() + 63) / 64, 0);
+      }
+      C.gather(C.patients.genotypeMatrixColumns(), C.matrix_aligned,
+            C.matrix ? &columns : nullptr, *this, out);
+   }
+
+   bool matches(const Patient& P) const
+   {
+      std::shared_ptr<Genotype> g = P.genotype();
+      if (!g || !g->schema())
+         return false;
+      size_t v = g->schema()->indexOfLocation(site);
+      if (v == g->schema()->NonExistantField)
+         return false;
+      char call;
+      g->variantRange(v, 1, &call);
+      return std::find(calls.begin(), calls.end(), call) != calls.end();
+   }
+};
+
+//All or any of the parts, which are evaluated in order. Evaluation stops
+//once the result can no longer change.
+class Combination : public PatientFilter::Node
+{
+public:
+   bool is_and;
+   std::vector<std::shared_ptr<const PatientFilter::Node>> parts;
+
+   Combination(bool a) : is_and(a) { }
+
+   void evaluate(FilterContext& C, std::vector<uint64_t>& out) const
+   {
+      parts[0]->evaluate(C, out);
+      std::vector<uint64_t> part;
+      size_t n = C.patients.size();
+      for (size_t k = 1; k < parts.size(); ++k){
+         //whether any patient's bit can still change
+         uint64_t open = 0;
+         for (size_t w = 0; w < out.size(); ++w){
+            uint64_t b = is_and ? out[w] : ~out[w];
+            if (w == n / 64)
+               b &= ((uint64_t)1 << (n % 64)) - 1;
+            open |= b;
+         }
+         if (open == 0)
+            break;
+         parts[k]->evaluate(C, part);
+         for (size_t w = 0; w < out.size(); ++w)
+            out[w] = is_and ? (out[w] & part[w]) : (out[w] | part[w]);
+      }
+   }
+
+   bool matches(const Patient& P) const
+   {
+      for (auto p = parts.begin(); p != parts.end(); ++p){
+         if ((*p)->matches(P) != is_and)
+            return !is_and;
+      }
+      return is_and;
+   }
+};
+
+class Negation : public PatientFilter::Node
+{
+private:
+   std::shared_ptr<const PatientFilter::Node> part;
+public:
+   Negation(std::shared_ptr<const PatientFilter::Node> p) : part(p) { }
+
+   void evaluate(FilterContext& C, std::vector<uint64_t>& out) const
+   {
+      part->evaluate(C, out);
+      for (auto w = out.begin(); w != out.end(); ++w)
+         *w = ~*w;
+      size_t n = C.patients.size();
+      if (n % 64 != 0)
+         out.back() &= ((uint64_t)1 << (n % 64)) - 1;
+   }
+
+   bool matches(const Patient& P) const
+   {
+      return !part->matches(P);
+   }
+};
+
+//Joins a and b, merging in the parts of either that is already a
+//Combination of the same kind.
+std::shared_ptr<const PatientFilter::Node> combine(bool is_and,
+      std::shared_ptr<const PatientFilter::Node> a,
+      std::shared_ptr<const PatientFilter::Node> b)
+{
+   std::shared_ptr<Combination> c(new Combination(is_and));
+   std::shared_ptr<const PatientFilter::Node> both[] = {a, b};
+   for (auto n : both){
+      const Combination* sub = dynamic_cast<const Combination*>(n.get());
+      if (sub && sub->is_and == is_and)
+         c->parts.insert(c->parts.end(), sub->parts.begin(),
+               sub->parts.end());
+      else
+         c->parts.push_back(n);
+   }
+   return c;
+}
+
+}
+
+PatientFilter PatientFilter::compare(const std::string& field, CompareOp op,
+      const CompactValue& v)
+{
+   if (v.isBoxed())
+      throw std::invalid_argument("Compare strings with the string overload");
+   return PatientFilter(std::make_shared<CompareTest>(field, op, v));
+}
+
+PatientFilter PatientFilter::compare(const std::string& field, CompareOp op,
+      int v)
+{
+   return compare(field, op, CompactValue(v));
+}
+
+PatientFilter PatientFilter::compare(const std::string& field, CompareOp op,
+      double v)
+{
+   return compare(field, op, CompactValue(v));
+}
+
+PatientFilter PatientFilter::compare(const std::string& field, CompareOp op,
+      const std::string& v)
+{
+   return PatientFilter(std::make_shared<CompareTest>(field, op, v));
+}
+
+PatientFilter PatientFilter::dateBetween(const std::string& field,
+      date::Days first, date::Days last)
+{
+   return PatientFilter(std::make_shared<DateTest>(field, first, last));
+}
+
+PatientFilter PatientFilter::isMissing(const std::string& field)
+{
+   return PatientFilter(std::make_shared<MissingTest>(field));
+}
+
+PatientFilter PatientFilter::genotypeIn(const GenomicLocation& site,
+      const std::vector<char>& calls)
+{
+   return PatientFilter(std::make_shared<GenotypeTest>(site, calls));
+}
+
+PatientFilter PatientFilter::genotypeIs(const GenomicLocation& site,
+      char call)
+{
+   return genotypeIn(site, std::vector<char>(1, call));
+}
+
+PatientFilter PatientFilter::operator&&(const PatientFilter& other) const
+{
+   return PatientFilter(combine(true, root, other.root));
+}
+
+PatientFilter PatientFilter::operator||(const PatientFilter& other) const
+{
+   return PatientFilter(combine(false, root, other.root));
+}
+
+PatientFilter PatientFilter::operator!() const
+{
+   return PatientFilter(std::make_shared<Negation>(root));
+}
+
+std::vector<uint64_t> PatientFilter::evaluate(const PatientSet& S,
+      unsigned n_threads, std::vector<IndexUse>* used) const
+{
+   FilterContext C(S, n_threads, used);
+   std::vector<uint64_t> out;
+   root->evaluate(C, out);
+   return out;
+}
+
+PatientSelection PatientFilter::selection(const PatientSet& S,
+      unsigned n_threads, std::vector<IndexUse>* used) const
+{
+   return PatientSelection(S, evaluate(S, n_threads, used));
+}
+
+bool PatientFilter::matches(const Patient& P) const
+{
+   return root->matches(P);
+}
+
+PatientPredicate PatientFilter::asPredicate() const
+{
+   std::shared_ptr<const Node> n = root;
+   return [n](const Patient& P) {return n->matches(P);};
+}
+
+}//namespace patients
+}//namespace cge
@@ -0,0 +1,80 @@
+#ifndef PATIENTFILTER_H
+#define PATIENTFILTER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "PatientSet.h"
+#include "ClinicalTable.h"
+
+namespace cge{
+   namespace patients{
+
+class FilterContext;
+
+//How PatientFilter::evaluate answered a test on a clinical field of the 
+//set's ClinicalTable: from the field's index (see PatientSet::createIndex)
+//or, for None, by scanning the column.
+struct IndexUse
+{
+   std::string field;
+   IndexKind index;
+};
+
+//A condition on patients built from comparisons on clinical fields, date
+//ranges and genotype calls, combined with &&, || and !. Unlike a
+//PatientPredicate its parts can be seen, so evaluate() runs each test a
+//column at a time over the set's ClinicalTable and GenotypeMatrix, for the
+//patients placed in them by setClinicalTable and setGenotypeMatrix (see 
+//PatientSet::clinicalTableRows), and combines the results as bitmaps. Other
+//patients are tested one at a time.
+//
+//A test on a missing value, or on a field or site a patient doesn't have,
+//is false; ! of it is true.
+class PatientFilter
+{
+public:
+   class Node;
+private:
+   std::shared_ptr<const Node> root;
+   explicit PatientFilter(std::shared_ptr<const Node> n) : root(n) { }
+public:
+   //field op v, compared as compareValues does. v must not be boxed;
+   //strings use the std::string overload.
+   static PatientFilter compare(const std::string& field, CompareOp op,
+         const CompactValue& v);
+   static PatientFilter compare(const std::string& field, CompareOp op,
+         int v);
+   static PatientFilter compare(const std::string& field, CompareOp op,
+         double v);
+   static PatientFilter compare(const std::string& field, CompareOp op,
+         const std::string& v);
+   //field holds a date from first to last, inclusive.
+   static PatientFilter dateBetween(const std::string& field,
+         date::Days first, date::Days last);
+   static PatientFilter isMissing(const std::string& field);
+   //The patient's call at site is one of calls.
+   static PatientFilter genotypeIn(const GenomicLocation& site,
+         const std::vector<char>& calls);
+   static PatientFilter genotypeIs(const GenomicLocation& site, char call);
+
+   PatientFilter operator&&(const PatientFilter& other) const;
+   PatientFilter operator||(const PatientFilter& other) const;
+   PatientFilter operator!() const;
+
+   //Bit i (of word i / 64) is set if patient i of S matches. Patient by
+   //patient work is split over n_threads threads (0 for one per core).
+   //If used is given, each test run against the table is appended to it.
+   //Throws std::invalid_argument if a comparison mixes types that can't be
+   //compared.
+   std::vector<uint64_t> evaluate(const PatientSet& S,
+         unsigned n_threads = 0, std::vector<IndexUse>* used = nullptr) const;
+   PatientSelection selection(const PatientSet& S,
+         unsigned n_threads = 0, std::vector<IndexUse>* used = nullptr) const;
+   bool matches(const Patient& P) const;
+   PatientPredicate asPredicate() const;
+};
+
+}//namespace patients
+}//namespace cge
+#endif
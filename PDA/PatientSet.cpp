@@ -1,16 +1,31 @@
 #include "PatientSet.h"
+#include <bitset>
+#include <algorithm>
+#include "Parallel.h"
 
 namespace cge{
    namespace patients{
    
+const size_t PatientSet::NoRow;
+
 void PatientSet::appendPatient(std::shared_ptr<Patient> P)
 {
    patient_set.push_back(P);
+   if (genotype_matrix)
+      matrix_columns.push_back(NoRow);
+   if (clinical_table)
+      table_rows.push_back(NoRow);
+   matrix_aligned = table_aligned = false;
 }
 
 void PatientSet::removePatient(size_t i)
 {
    patient_set.erase(patient_set.begin() + i);
+   if (genotype_matrix)
+      matrix_columns.erase(matrix_columns.begin() + i);
+   if (clinical_table)
+      table_rows.erase(table_rows.begin() + i);
+   matrix_aligned = table_aligned = false;
 }
 
 const std::vector<std::shared_ptr<const Patient>> PatientSet::asVector()
@@ -21,49 +36,324 @@ const std::vector<std::shared_ptr<const Patient>> PatientSet::asVector()
    return (const std::vector<std::shared_ptr<const Patient>>)const_patient_set;
 }
 
-PatientSet PatientSet::select(PatientPredicate f)
+//The patients for which f holds, as a new set sharing them. f is evaluated
+//over n_threads threads (0 for one per core), so it must be safe to call
+//concurrently; pass 1 to evaluate it serially.
+PatientSet PatientSet::select(PatientPredicate f, unsigned n_threads)
+{
+   return selection(f, n_threads).toPatientSet();
+}
+
+//As select, but without copying the patients.
+PatientSelection PatientSet::selection(PatientPredicate f, 
+      unsigned n_threads) const
+{
+   return PatientSelection(*this, selectionBitmap(f, n_threads));
+}
+
+//Bit i (of word i / 64) is set when f holds for patient i. See select for
+//n_threads.
+std::vector<uint64_t> PatientSet::selectionBitmap(PatientPredicate f,
+      unsigned n_threads) const
+{
+   std::vector<uint64_t> bits((patient_set.size() + 63) / 64, 0);
+   //ranges start on word boundaries so no two threads write the same word
+   utility::parallelRanges(patient_set.size(), n_threads, 64, 
+         [&](size_t first, size_t last)
+   {
+      for (size_t i = first; i < last; ++i){
+         if (f(*patient_set[i]))
+            bits[i / 64] |= uint64_t(1) << (i % 64);
+      }
+   });
+   return bits;
+}
+
+//Keeps only the patients for which f holds. See select for n_threads.
+void PatientSet::restrict(PatientPredicate f, unsigned n_threads)
 {
-   PatientSet new_set;
-   for(std::shared_ptr<Patient> p : patient_set){
-      if (f(*p)) 
-         new_set.appendPatient(p);
+   compact(selectionBitmap(f, n_threads));
+}
+
+//Removes the patients for which f holds. See select for n_threads.
+void PatientSet::discard(PatientPredicate f, unsigned n_threads)
+{
+   std::vector<uint64_t> keep = selectionBitmap(f, n_threads);
+   for (auto w = keep.begin(); w != keep.end(); ++w)
+      *w = ~*w;
+   compact(keep);
+}
+
+//Keeps the patients whose bit is set in keep, in order, in one pass.
+void PatientSet::compact(const std::vector<uint64_t>& keep)
+{
+   if (keep.size() != (patient_set.size() + 63) / 64)
+      throw std::invalid_argument("Bitmap does not match the patient set");
+   size_t kept = 0;
+   for (size_t i = 0; i < patient_set.size(); ++i){
+      if (keep[i / 64] >> (i % 64) & 1){
+         if (kept != i){
+            patient_set[kept] = std::move(patient_set[i]);
+            if (genotype_matrix)
+               matrix_columns[kept] = matrix_columns[i];
+            if (clinical_table)
+               table_rows[kept] = table_rows[i];
+         }
+         ++kept;
+      }
    }
-   return new_set;
+   if (kept != patient_set.size())
+      matrix_aligned = table_aligned = false;
+   patient_set.resize(kept);
+   if (genotype_matrix)
+      matrix_columns.resize(kept);
+   if (clinical_table)
+      table_rows.resize(kept);
+}
+
+size_t PatientSet::size() const
+{
+   return patient_set.size();
+}
+
+std::shared_ptr<GenotypeMatrix> PatientSet::genotypeMatrix() const
+{
+   return genotype_matrix;
 }
 
-void PatientSet::restrict(PatientPredicate f)
+//The matrix column patient i's genotype views, or NoRow; see 
+//clinicalTableRows.
+const std::vector<size_t>& PatientSet::genotypeMatrixColumns() const
 {
-   bool removed_one = false;
+   return matrix_columns;
+}
+
+//Gives the patient at position i a Genotype viewing column i of M. M must
+//have a column for every patient. Patients whose genotype is on a schema
+//other than M's keep it and are left out of the matrix (their column is 
+//NoRow in genotypeMatrixColumns).
+void PatientSet::setGenotypeMatrix(std::shared_ptr<GenotypeMatrix> M)
+{
+   if (M->patientCount() != patient_set.size())
+      throw std::invalid_argument("Matrix does not match the patient set");
+   genotype_matrix = M;
+   matrix_columns.resize(patient_set.size());
+   matrix_aligned = true;
    for(size_t i = 0; i < patient_set.size(); ++i){
-      if (removed_one){
-         --i;
-         removed_one = false;
-      }
-      if(!f(*(patient_set.at(i)))){
-         this->removePatient(i);
-         removed_one = true;
+      std::shared_ptr<Genotype> g = patient_set.at(i)->genotype();
+      if (g && g->schema() != M->schema()){
+         matrix_columns[i] = NoRow;
+         matrix_aligned = false;
+         continue;
       }
+      matrix_columns[i] = i;
+      std::shared_ptr<Genotype> view(new Genotype(M, i));
+      if (g)
+         view->setPopulation(g->population());
+      patient_set.at(i)->setGenotype(view);
    }
 }
 
-void PatientSet::discard(PatientPredicate f)
+//Builds a cohort matrix over S, copying in the calls of every patient whose
+//genotype already uses S, and makes those patients' genotypes, and those of
+//patients without one, views into it. Sites a patient has no call for are
+//missing. Patients with a genotype on another schema are left alone, as in
+//setGenotypeMatrix. Throws std::invalid_argument, changing no patient, if a
+//call has no 2 bit code (see PackedGenotypes).
+std::shared_ptr<GenotypeMatrix> PatientSet::buildGenotypeMatrix
+   (std::shared_ptr<GenotypeSchema> S)
 {
-   bool removed_one = false;
+   std::shared_ptr<GenotypeMatrix> M(new GenotypeMatrix(S, patient_set.size()));
+   const char missing = PackedGenotypes::toChar(PackedGenotypes::Missing);
+   for(size_t i = 0; i < patient_set.size(); ++i){
+      std::shared_ptr<Genotype> g = patient_set.at(i)->genotype();
+      std::vector<char> calls;
+      if (g && g->schema() == S)
+         calls = g->variantsAsVector();
+      for (size_t v = 0; v < M->variantCount(); ++v)
+         M->setVariant(v, i, (v < calls.size()) ? calls[v] : missing);
+   }
+   setGenotypeMatrix(M);
+   return M;
+}
+
+std::shared_ptr<ClinicalTable> PatientSet::clinicalTable() const
+{
+   return clinical_table;
+}
+
+//The table row patient i's record views, or NoRow for patients appended 
+//since setClinicalTable. PatientFilter reads clinical values from these 
+//rows, so a patient given another record after setClinicalTable is only
+//seen by it after refreshViews.
+const std::vector<size_t>& PatientSet::clinicalTableRows() const
+{
+   return table_rows;
+}
+
+//Gives the patient at position i a ClinicalRecord viewing row i of T. T must
+//have a row for every patient. Patients whose record is on a schema other 
+//than T's keep it and are left out of the table (their row is NoRow in 
+//clinicalTableRows).
+void PatientSet::setClinicalTable(std::shared_ptr<ClinicalTable> T)
+{
+   if (T->patientCount() != patient_set.size())
+      throw std::invalid_argument("Table does not match the patient set");
+   clinical_table = T;
+   for (auto f = indexed_fields.begin(); f != indexed_fields.end(); ++f){
+      size_t pos = T->schema()->indexOfField(*f);
+      if (pos != T->schema()->NonExistantField)
+         T->createIndex(pos);
+   }
+   table_rows.resize(patient_set.size());
+   table_aligned = true;
    for(size_t i = 0; i < patient_set.size(); ++i){
-      if (removed_one){
-         --i;
-         removed_one = false;
+      std::shared_ptr<ClinicalRecord> r = patient_set.at(i)->clinicalRecord();
+      if (r && r->schema() != T->schema()){
+         table_rows[i] = NoRow;
+         table_aligned = false;
+         continue;
       }
-      if(f(*(patient_set.at(i)))){
-         this->removePatient(i);
-         removed_one = true;
+      table_rows[i] = i;
+      patient_set.at(i)->setClinicalRecord(
+            std::shared_ptr<ClinicalRecord>(new ClinicalRecord(T, i)));
+   }
+}
+
+//Recomputes clinicalTableRows and genotypeMatrixColumns from the patients'
+//records and genotypes, for when some have been replaced or detached from 
+//the table or matrix since they were set.
+void PatientSet::refreshViews()
+{
+   matrix_aligned = genotype_matrix && 
+      genotype_matrix->patientCount() == patient_set.size();
+   table_aligned = clinical_table && 
+      clinical_table->patientCount() == patient_set.size();
+   for (size_t i = 0; i < patient_set.size(); ++i){
+      if (clinical_table){
+         std::shared_ptr<ClinicalRecord> r = patient_set[i]->clinicalRecord();
+         table_rows[i] = (r && r->clinicalTable() == clinical_table) ? 
+            r->tableRow() : NoRow;
+         table_aligned &= (table_rows[i] == i);
+      }
+      if (genotype_matrix){
+         std::shared_ptr<Genotype> g = patient_set[i]->genotype();
+         matrix_columns[i] = (g && g->genotypeMatrix() == genotype_matrix) ?
+            g->matrixColumn() : NoRow;
+         matrix_aligned &= (matrix_columns[i] == i);
       }
    }
 }
 
-size_t PatientSet::size() const
+//Keeps an index on field in the set's clinical table, and in any table the
+//set is given later, for PatientFilter to use. Indexes follow writes to the
+//table. Throws std::invalid_argument if the set has a table without field.
+void PatientSet::createIndex(const std::string& field)
 {
-   return patient_set.size();
+   if (clinical_table){
+      size_t pos = clinical_table->schema()->indexOfField(field);
+      if (pos == clinical_table->schema()->NonExistantField)
+         throw std::invalid_argument("No field " + field + " in the table");
+      clinical_table->createIndex(pos);
+   }
+   if (!hasIndex(field))
+      indexed_fields.push_back(field);
+}
+
+void PatientSet::dropIndex(const std::string& field)
+{
+   auto f = std::find(indexed_fields.begin(), indexed_fields.end(), field);
+   if (f == indexed_fields.end())
+      return;
+   indexed_fields.erase(f);
+   if (clinical_table){
+      size_t pos = clinical_table->schema()->indexOfField(field);
+      if (pos != clinical_table->schema()->NonExistantField)
+         clinical_table->dropIndex(pos);
+   }
+}
+
+bool PatientSet::hasIndex(const std::string& field) const
+{
+   return std::find(indexed_fields.begin(), indexed_fields.end(), field) !=
+      indexed_fields.end();
+}
+
+//Builds a cohort table over S, copying in the values of every patient whose
+//clinical record already uses S, and makes those patients' records, and 
+//those of patients without one, views into it. Patients with a record on 
+//another schema are left alone, as in setClinicalTable.
+std::shared_ptr<ClinicalTable> PatientSet::buildClinicalTable
+   (std::shared_ptr<ClinicalSchema> S)
+{
+   std::shared_ptr<ClinicalTable> T(new ClinicalTable(S, patient_set.size()));
+   for(size_t i = 0; i < patient_set.size(); ++i){
+      std::shared_ptr<ClinicalRecord> r = patient_set.at(i)->clinicalRecord();
+      if (!r || r->schema() != S)
+         continue;
+      const std::vector<CompactValue> values = r->valuesAsVector();
+      for (size_t f = 0; f < values.size(); ++f){
+         if (values[f].typeTag() == ClinicalType::History)
+            T->setHistory(f, i, r->sharedHistory(f));
+         else
+            T->setValue(f, i, values[f]);
+      }
+   }
+   setClinicalTable(T);
+   return T;
+}
+
+//The value as of date of every patient's History field, in a column with one
+//row per patient. Patients without the field or without a point by then are
+//missing.
+std::unique_ptr<ClinicalColumn> PatientSet::historySnapshot(
+      const std::string& field, date::Days date, unsigned n_threads) const
+{
+   return historySnapshot(field, 
+         std::vector<date::Days>(patient_set.size(), date), n_threads);
+}
+
+//As above, with patient i taken as of dates[i]. The lookups are split over
+//n_threads threads (0 for one per core). Throws std::invalid_argument if a
+//patient's field holds something other than a history, or the histories 
+//hold values of different types.
+std::unique_ptr<ClinicalColumn> PatientSet::historySnapshot(
+      const std::string& field, const std::vector<date::Days>& dates,
+      unsigned n_threads) const
+{
+   if (dates.size() != patient_set.size())
+      throw std::invalid_argument("Need one date per patient");
+   std::vector<CompactValue> values(patient_set.size());
+   auto snapshotRange = [&](size_t first, size_t last)
+   {
+      //records mostly share a schema, so the field is looked up once per
+      //schema rather than once per patient
+      std::shared_ptr<ClinicalSchema> schema;
+      size_t pos = 0;
+      for (size_t i = first; i < last; ++i){
+         std::shared_ptr<ClinicalRecord> r = patient_set[i]->clinicalRecord();
+         if (!r || !r->schema())
+            continue;
+         if (r->schema() != schema){
+            schema = r->schema();
+            pos = schema->indexOfField(field);
+         }
+         if (pos == schema->NonExistantField)
+            continue;
+         CompactValue h = r->value(pos);
+         if (h.isMissing())
+            continue;
+         values[i] = h.asHistory().valueAtDate(dates[i]);
+      }
+   };
+   utility::parallelRanges(patient_set.size(), n_threads, 1, snapshotRange);
+   std::unique_ptr<ClinicalColumn> column(
+         new ClinicalColumn(patient_set.size()));
+   for (size_t i = 0; i < values.size(); ++i){
+      if (!values[i].isMissing())
+         column->set(i, values[i]);
+   }
+   return column;
 }
 
 std::shared_ptr<Patient> PatientSet::operator[](size_t i)
@@ -80,5 +370,43 @@ const std::shared_ptr<Patient> PatientSet::operator[](size_t i) const
    return patient_set.at(i);
 }
 
+PatientSelection::PatientSelection(const PatientSet& S, 
+      std::vector<uint64_t> bitmap) : patient_set(&S), bits(std::move(bitmap)),
+   n_selected(0)
+{
+   if (bits.size() != (S.size() + 63) / 64)
+      throw std::invalid_argument("Bitmap does not match the patient set");
+   //bits past the last patient are not part of the selection
+   if (S.size() % 64 != 0)
+      bits.back() &= (uint64_t(1) << (S.size() % 64)) - 1;
+   for (auto w = bits.begin(); w != bits.end(); ++w)
+      n_selected += std::bitset<64>(*w).count();
+}
+
+bool PatientSelection::isSelected(size_t i) const
+{
+   if (i >= patient_set->size())
+      throw std::out_of_range("Index out of bounds");
+   return bits[i / 64] >> (i % 64) & 1;
+}
+
+std::vector<size_t> PatientSelection::indices() const
+{
+   std::vector<size_t> out;
+   out.reserve(n_selected);
+   forEach([&](size_t i, const Patient&) {out.push_back(i);});
+   return out;
+}
+
+PatientSet PatientSelection::toPatientSet() const
+{
+   PatientSet S;
+   forEach([&](size_t i, const Patient&) 
+   {
+      S.appendPatient(patient_set->begin()[i]);
+   });
+   return S;
+}
+
 }//namespace patients
 }//namespace cge
@@ -1,31 +1,77 @@
 #ifndef PATIENTSET_H
 #define PATIENTSET_H
 
+#include <functional>
+#include <limits>
 #include "Patient.h"
 
 namespace cge{
    namespace patients{
    
 using PatientPredicate = std::function<bool(const Patient& P)>;
+class PatientSelection;
+
 class PatientSet
 {
 private: 
    std::vector<std::shared_ptr<Patient>> patient_set;
+   std::shared_ptr<GenotypeMatrix> genotype_matrix;
+   std::shared_ptr<ClinicalTable> clinical_table;
+   //the matrix column and table row of each patient, kept in step with 
+   //patient_set while there is a matrix or table
+   std::vector<size_t> matrix_columns;
+   std::vector<size_t> table_rows;
+   //patient i is column (row) i, for every column (row)
+   bool matrix_aligned;
+   bool table_aligned;
+   //clinical fields to index in whichever table the set has
+   std::vector<std::string> indexed_fields;
 public:
+   static const size_t NoRow = std::numeric_limits<size_t>::max();
+
    typedef std::vector<std::shared_ptr<Patient>>::iterator iterator;
    typedef std::vector<std::shared_ptr<Patient>>::const_iterator const_iterator;
    
-   PatientSet()
+   PatientSet() : matrix_aligned(false), table_aligned(false)
    {
       patient_set.reserve(1);
    }
    void appendPatient(std::shared_ptr<Patient> P);
    void removePatient(size_t i);
    const std::vector<std::shared_ptr<const Patient>> asVector();
-   PatientSet select(PatientPredicate f);
-   void restrict(PatientPredicate f);
-   void discard(PatientPredicate f);
+   //Work over the patients is split over n_threads threads, by default one
+   //per core, here and in historySnapshot. f is called concurrently unless
+   //n_threads is 1, so it must be safe to call from several threads.
+   PatientSet select(PatientPredicate f, unsigned n_threads = 0);
+   PatientSelection selection(PatientPredicate f, unsigned n_threads = 0) 
+      const;
+   std::vector<uint64_t> selectionBitmap(PatientPredicate f, 
+         unsigned n_threads = 0) const;
+   void restrict(PatientPredicate f, unsigned n_threads = 0);
+   void discard(PatientPredicate f, unsigned n_threads = 0);
+   void compact(const std::vector<uint64_t>& keep);
    size_t size() const;
+   std::shared_ptr<GenotypeMatrix> genotypeMatrix() const;
+   void setGenotypeMatrix(std::shared_ptr<GenotypeMatrix> M);
+   std::shared_ptr<GenotypeMatrix> 
+      buildGenotypeMatrix(std::shared_ptr<GenotypeSchema> S);
+   const std::vector<size_t>& genotypeMatrixColumns() const;
+   bool genotypeMatrixAligned() const {return matrix_aligned;}
+   std::shared_ptr<ClinicalTable> clinicalTable() const;
+   const std::vector<size_t>& clinicalTableRows() const;
+   //True while patient i's record is row i of the table, for every row.
+   bool clinicalTableAligned() const {return table_aligned;}
+   void refreshViews();
+   void createIndex(const std::string& field);
+   void dropIndex(const std::string& field);
+   bool hasIndex(const std::string& field) const;
+   void setClinicalTable(std::shared_ptr<ClinicalTable> T);
+   std::shared_ptr<ClinicalTable> 
+      buildClinicalTable(std::shared_ptr<ClinicalSchema> S);
+   std::unique_ptr<ClinicalColumn> historySnapshot(const std::string& field,
+         date::Days date, unsigned n_threads = 0) const;
+   std::unique_ptr<ClinicalColumn> historySnapshot(const std::string& field,
+         const std::vector<date::Days>& dates, unsigned n_threads = 0) const;
 
    std::shared_ptr<Patient> operator[](size_t i);
    const std::shared_ptr<Patient> operator[](size_t i) const;
@@ -36,6 +82,41 @@ public:
    const_iterator end() const {return patient_set.end();}
 };
 
+//The patients of a PatientSet for which a predicate held, kept as a bitmap 
+//over the set's positions rather than as copies of the patients. The set
+//must outlive the selection and not change while it is in use.
+class PatientSelection
+{
+private:
+   const PatientSet* patient_set;
+   std::vector<uint64_t> bits;
+   size_t n_selected;
+public:
+   PatientSelection(const PatientSet& S, std::vector<uint64_t> bitmap);
+   const PatientSet& patientSet() const {return *patient_set;}
+   //number of selected patients
+   size_t size() const {return n_selected;}
+   bool isSelected(size_t i) const;
+   const std::vector<uint64_t>& bitmap() const {return bits;}
+   std::vector<size_t> indices() const;
+   PatientSet toPatientSet() const;
+   template <typename Visitor>
+   void forEach(Visitor visit) const;
+};
+
+//Calls visit(i, const Patient&) for each selected patient, in order.
+template <typename Visitor>
+void PatientSelection::forEach(Visitor visit) const
+{
+   for (size_t w = 0; w < bits.size(); ++w){
+      uint64_t word = bits[w];
+      for (size_t i = w * 64; word != 0; ++i, word >>= 1){
+         if (word & 1)
+            visit(i, *patient_set->begin()[i]);
+      }
+   }
+}
+
 }//namespace patients
 }//namespace cge
 #endif
@@ -10,6 +10,7 @@ class ReferenceGenome
 {
 protected:
    ReferenceGenome(){}
+   ReferenceGenome(const std::string& name) : ref_name(name) {}
    ~ReferenceGenome(){}
    ReferenceGenome(const ReferenceGenome&);        //Prevent copy-construction
    ReferenceGenome& operator=(const ReferenceGenome&);    //Prevent assignment 
@@ -35,11 +36,10 @@ inline bool operator==
 class GENOME_HG19 : public ReferenceGenome
 {
 private:
-   GENOME_HG19(){}
+   GENOME_HG19() : ReferenceGenome("GENOME_HG19") {}
    ~GENOME_HG19(){}
    GENOME_HG19(const GENOME_HG19&);
    GENOME_HG19& operator=(const GENOME_HG19&);
-   const std::string ref_name = "GENOME_HG19";
 public:
    static GENOME_HG19& Instance()
    {
@@ -48,6 +48,21 @@ public:
    }
 };
 
+class GENOME_HG38 : public ReferenceGenome
+{
+private:
+   GENOME_HG38() : ReferenceGenome("GENOME_HG38") {}
+   ~GENOME_HG38(){}
+   GENOME_HG38(const GENOME_HG38&);
+   GENOME_HG38& operator=(const GENOME_HG38&);
+public:
+   static GENOME_HG38& Instance()
+   {
+      static GENOME_HG38 singleton;
+      return singleton;  
+   }
+};
+
 }//namespace patients
 }//namespace cge
 #endif
@@ -0,0 +1,136 @@
+#include "ReferenceSequence.h"
+#include "StringFunctions.h"
+#include <fstream>
+#include <stdexcept>
+#include <cctype>
+
+namespace cge{
+   namespace patients{
+
+namespace{
+
+//Chromosome number of a FASTA sequence name such as "chr12", or -1.
+int chromosomeNumber(const std::string& name)
+{
+   utility::StringRef s(name.data(), name.size());
+   if (s.size > 3 && name.compare(0, 3, "chr") == 0)
+      s = utility::StringRef(s.data + 3, s.size - 3);
+   if (s.empty() || s.size > 9)
+      return -1;
+   for (size_t i = 0; i < s.size; ++i){
+      if (s[i] < '0' || s[i] > '9')
+         return -1;
+   }
+   return (int)utility::toInteger(s);
+}
+
+}
+
+ReferenceSequence::ReferenceSequence(const std::string& path,
+      ReferenceGenome& ref) : ref_genome(&ref)
+{
+   fasta_file.reset(new utility::MappedFile(path));
+   if (!readIndex(path + ".fai"))
+      scan();
+}
+
+//Reads a faidx index: name, length, offset, bases per line and bytes per
+//line, tab separated. Returns false if there is no index.
+bool ReferenceSequence::readIndex(const std::string& fai_path)
+{
+   std::ifstream fai(fai_path.c_str());
+   if (!fai)
+      return false;
+   std::string line;
+   std::vector<utility::StringRef> cols;
+   while (std::getline(fai, line)){
+      if (line.empty())
+         continue;
+      if (utility::split(utility::StringRef(line), '\t', cols) < 5)
+         throw std::invalid_argument("Malformed FASTA index line: " + line);
+      int chrom = chromosomeNumber(cols[0].str());
+      if (chrom < 0)
+         continue;
+      Contig c;
+      c.length = (size_t)utility::toInteger(cols[1]);
+      c.offset = (size_t)utility::toInteger(cols[2]);
+      c.line_bases = (size_t)utility::toInteger(cols[3]);
+      c.line_width = (size_t)utility::toInteger(cols[4]);
+      if (c.line_bases == 0 || c.line_width < c.line_bases ||
+            c.offset > fasta_file->size())
+         throw std::invalid_argument("Malformed FASTA index line: " + line);
+      contigs[chrom] = c;
+   }
+   return true;
+}
+
+//Finds each sequence's bases by reading the whole file.
+void ReferenceSequence::scan()
+{
+   const char* p = fasta_file->begin();
+   const char* end = fasta_file->end();
+   while (p < end){
+      if (*p != '>')
+         throw std::invalid_argument("FASTA sequence without a header");
+      const char* name_end = p + 1;
+      while (name_end < end && !std::isspace((unsigned char)*name_end))
+         ++name_end;
+      int chrom = chromosomeNumber(std::string(p + 1, name_end));
+      while (p < end && *p != '\n')
+         ++p;
+      if (p < end)
+         ++p;
+      Contig c;
+      c.offset = p - fasta_file->begin();
+      c.length = 0;
+      c.line_bases = 0;
+      c.line_width = 0;
+      while (p < end && *p != '>'){
+         const char* line_end = p;
+         while (line_end < end && *line_end != '\n')
+            ++line_end;
+         size_t bases = line_end - p;
+         if (bases > 0 && p[bases - 1] == '\r')
+            --bases;
+         if (c.line_bases == 0){
+            c.line_bases = bases;
+            c.line_width = line_end - p + (line_end < end ? 1 : 0);
+         }
+         c.length += bases;
+         p = (line_end < end) ? line_end + 1 : end;
+      }
+      if (chrom >= 0 && c.line_bases > 0)
+         contigs[chrom] = c;
+   }
+}
+
+size_t ReferenceSequence::chromosomeLength(int chrom) const
+{
+   auto c = contigs.find(chrom);
+   return (c == contigs.end()) ? 0 : c->second.length;
+}
+
+std::string ReferenceSequence::sequence(int chrom, int pos,
+      size_t length) const
+{
+   auto found = contigs.find(chrom);
+   if (found == contigs.end() || pos < 1)
+      return "";
+   const Contig& c = found->second;
+   size_t first = (size_t)pos - 1;
+   if (first > c.length || length > c.length - first)
+      return "";
+   std::string bases(length, 'N');
+   for (size_t i = 0; i < length; ++i){
+      size_t b = first + i;
+      size_t at = c.offset + (b / c.line_bases) * c.line_width +
+         b % c.line_bases;
+      if (at >= fasta_file->size())
+         return "";
+      bases[i] = (char)std::toupper((unsigned char)fasta_file->data()[at]);
+   }
+   return bases;
+}
+
+}//namespace patients
+}//namespace cge
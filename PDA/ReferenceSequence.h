@@ -0,0 +1,56 @@
+#ifndef REFERENCESEQUENCE_H
+#define REFERENCESEQUENCE_H
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "MappedFile.h"
+#include "ReferenceGenome.h"
+
+namespace cge{
+   namespace patients{
+
+//Read-only access to the bases of a reference genome held in a FASTA file
+//(e.g. hg38.fa from the UCSC downloads page). The file is memory mapped.
+//If a samtools faidx index (path + ".fai") is next to it, the sequences are
+//found through it; otherwise the file is scanned once when opened, and its
+//lines must be of equal length within each sequence, as faidx requires.
+//Sequences without a number (chrX, alternate contigs, ...) are left out.
+class ReferenceSequence
+{
+private:
+   //where a sequence's bases are in the file
+   struct Contig
+   {
+      size_t offset;
+      size_t length;
+      size_t line_bases;
+      size_t line_width;   //line_bases plus the line ending
+   };
+   std::unique_ptr<utility::MappedFile> fasta_file;
+   std::unordered_map<int, Contig> contigs;
+   ReferenceGenome* ref_genome;
+   ReferenceSequence(const ReferenceSequence&);             //Prevent copy-construction
+   ReferenceSequence& operator=(const ReferenceSequence&);  //Prevent assignment
+
+   bool readIndex(const std::string& fai_path);
+   void scan();
+public:
+   //Maps the FASTA file at path, holding the sequence of ref. Throws
+   //std::runtime_error if it cannot be opened, std::invalid_argument if it
+   //or its index is malformed.
+   ReferenceSequence(const std::string& path, ReferenceGenome& ref);
+
+   ReferenceGenome& reference() const {return *ref_genome;}
+   bool hasChromosome(int chrom) const {return contigs.count(chrom) != 0;}
+   //Number of bases of chrom, 0 if there is no such sequence.
+   size_t chromosomeLength(int chrom) const;
+
+   //The length bases of chrom starting at the 1-based position pos, in
+   //upper case, or "" if any of them is outside the sequence.
+   std::string sequence(int chrom, int pos, size_t length) const;
+};
+
+}//namespace patients
+}//namespace cge
+#endif
@@ -9,33 +9,29 @@ namespace cge{
 class Value
 {
 private:
-   std::shared_ptr<const ClinicalValue> clin_value;
-   std::shared_ptr<char> variant;
+   CompactValue clin_value;
+   bool is_clinical;
+   char variant;
 public: 
-   Value(const ClinicalValue* c) : 
-      clin_value((std::shared_ptr<const ClinicalValue>) c)
-   { 
-      variant = std::shared_ptr<char> (nullptr);
-   }
-   Value(char v) : variant(std::make_shared<char>(v))
-   { 
-      clin_value = std::shared_ptr<ClinicalValue> (nullptr);
-   }
+   Value(CompactValue c) : clin_value(c), is_clinical(true), variant(0)
+   { }
+   Value(char v) : is_clinical(false), variant(v)
+   { }
    bool isClinical()
    {
-      return (clin_value.get() != nullptr);
+      return is_clinical;
    }
    bool isVariant()
    {
-      return (variant.get() != nullptr);
+      return !is_clinical;
    }
    char getVariant()
    {
-      return *variant;
+      return variant;
    }
-   const ClinicalValue* getClinical()
+   CompactValue getClinical()
    {
-      return clin_value.get();
+      return clin_value;
    }
 
 };
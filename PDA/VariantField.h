@@ -3,44 +3,113 @@
 
 #include<string>
 #include<vector>
+#include<utility>
+#include<cstdint>
 #include"GenomicLocation.h"
 
 namespace cge{
    namespace patients{
-   
+
+//A sample's call at a site, one byte per allele holding the allele's index
+//into the site's allele list plus one; 0 marks a missing allele.
+typedef uint16_t GenotypeCode;
+
 class VariantField
 {
-private: 
+private:
    std::string variant_name;
    GenomicLocation variant_location;
    std::vector<std::string> seq_variants;
+   //compact per-sample calls, the alleles are stored once for the site
+   std::vector<std::string> site_alleles;
+   std::vector<GenotypeCode> sample_codes;
 public:
-   VariantField()
+   VariantField() { }
+
+   VariantField(std::string n, GenomicLocation l) :
+      variant_name(n), variant_location(l)
+   { }
+
+   static GenotypeCode encodeGenotype(int allele_1, int allele_2)
    {
-      seq_variants.resize(256);
+      if (allele_1 > 254 || allele_2 > 254)
+         throw std::out_of_range("Too many alleles to encode");
+      return (GenotypeCode)(((allele_1 + 1) << 8) | (allele_2 + 1));
    }
 
-   VariantField(std::string n, GenomicLocation l) : 
-      variant_name(n), variant_location(l)
+   static std::pair<int,int> decodeGenotype(GenotypeCode c)
    {
-      seq_variants.resize(256);
+      return std::make_pair((int)(c >> 8) - 1, (int)(c & 0xFF) - 1);
    }
 
    const std::string& name() const {return variant_name;}
-   
+
    void setName(const std::string& name) {variant_name = name;}
-   
+
    GenomicLocation location() const {return variant_location;}
-   
+
    void setLocation(GenomicLocation p) {variant_location = p;}
 
-   const std::vector<std::string> variantList() {return seq_variants;}
+   //Without an explicit variant list, the list is each sample's call written
+   //out as an "A|G" style string.
+   const std::vector<std::string> variantList() const
+   {
+      if (!seq_variants.empty() || sample_codes.empty())
+         return seq_variants;
+      std::vector<std::string> calls;
+      calls.reserve(sample_codes.size());
+      for (size_t i = 0; i < sample_codes.size(); ++i)
+         calls.push_back(sampleGenotypeString(i));
+      return calls;
+   }
 
    void setVariantList(std::vector<std::string> s){seq_variants = s;}
 
-   std::string variant(char i) const {return seq_variants.at(i);}
+   std::string variant(char i) const
+   {
+      size_t pos = (unsigned char)i;
+      if (pos < seq_variants.size())
+         return seq_variants[pos];
+      if (seq_variants.empty() && pos < sample_codes.size())
+         return sampleGenotypeString(pos);
+      return "";
+   }
 
-   void setVariant(char i, std::string s) {seq_variants.at(i) = s;}
+   void setVariant(char i, std::string s)
+   {
+      size_t pos = (unsigned char)i;
+      if (pos >= seq_variants.size())
+         seq_variants.resize(pos + 1);
+      seq_variants[pos] = s;
+   }
+
+   const std::vector<std::string>& alleles() const {return site_alleles;}
+
+   void setAlleles(std::vector<std::string> a) {site_alleles = a;}
+
+   size_t sampleCount() const {return sample_codes.size();}
+
+   const std::vector<GenotypeCode>& sampleGenotypes() const
+   {
+      return sample_codes;
+   }
+
+   void setSampleGenotypes(std::vector<GenotypeCode> c) {sample_codes = c;}
+
+   GenotypeCode sampleGenotype(size_t i) const {return sample_codes.at(i);}
+
+   std::pair<int,int> sampleAlleles(size_t i) const
+   {
+      return decodeGenotype(sample_codes.at(i));
+   }
+
+   std::string sampleGenotypeString(size_t i) const
+   {
+      std::pair<int,int> gt = sampleAlleles(i);
+      std::string gt_1 = (gt.first < 0) ? "." : site_alleles.at(gt.first);
+      std::string gt_2 = (gt.second < 0) ? "." : site_alleles.at(gt.second);
+      return gt_1 + "|" + gt_2;
+   }
 };
 
 }//namespace patients
@@ -1,7 +1,7 @@
 #ifndef ARFFWRITER_H
 #define ARFFWRITER_H
 
-#include "Genotype.h"
+#include "Patient.h"
 #include "StringFunctions.h"
 #include <iostream>
 #include <fstream>
@@ -31,8 +31,7 @@ bool writeARFFfromClinical(std::ostream& clin_file, Patient& P)
       clin_file << "@ATTRIBUTE required {true,false}\n";
       
       //get all info
-      const std::vector<std::shared_ptr<const ClinicalValue>> values = 
-         clin_rec->valuesAsVector();
+      const std::vector<CompactValue>& values = clin_rec->valuesAsVector();
       const std::vector<std::string> names= clin_rec->schema()->fieldNames();
       std::vector<bool> requires;
       for(auto it = names.begin(); it != names.end(); ++it)
@@ -41,33 +40,29 @@ bool writeARFFfromClinical(std::ostream& clin_file, Patient& P)
       //data writing
       clin_file << "@data\n";
       for (size_t i = 0; i < values.size(); ++i){
-         std::string val = values.at(i)->toString();
-         if(values.at(i)->type().compare("String") == 0){
-            clin_file << 
-               "" + val + ",?,?,?,?,?,";
-         }
-         else if (values.at(i)->type().compare("Bool") == 0){
-            clin_file << 
-               "?," + val + ",?,?,?,?,";
-         }
-         else if (values.at(i)->type().compare("Double") == 0){
-            clin_file << 
-               "?,?," + val + ",?,?,?,";
-         }
-         else if (values.at(i)->type().compare("Int") == 0){
-            clin_file << 
-               "?,?,?," + val + ",?,?,";
-         }
-         else if (values.at(i)->type().compare("Date") == 0){
-            clin_file << 
-               "?,?,?,?," + val + ",?,";
-         }
-         else if (values.at(i)->type().compare("History") == 0){
-            clin_file << 
-               "?,?,?,?,?," + val + ",";
-         }
-         else{
-            clin_file << "?,?,?,?,?,?,";
+         std::string val = values.at(i).toString();
+         switch (values.at(i).typeTag()){
+            case ClinicalType::String:
+               clin_file << "" + val + ",?,?,?,?,?,";
+               break;
+            case ClinicalType::Bool:
+               clin_file << "?," + val + ",?,?,?,?,";
+               break;
+            case ClinicalType::Double:
+               clin_file << "?,?," + val + ",?,?,?,";
+               break;
+            case ClinicalType::Int:
+               clin_file << "?,?,?," + val + ",?,?,";
+               break;
+            case ClinicalType::Date:
+               clin_file << "?,?,?,?," + val + ",?,";
+               break;
+            case ClinicalType::History:
+               clin_file << "?,?,?,?,?," + val + ",";
+               break;
+            default:
+               clin_file << "?,?,?,?,?,?,";
+               break;
          }
          std::string req;
          if (requires.at(i))
@@ -114,7 +109,8 @@ bool writeARFFfromGenomic(std::ostream& geno_file, Patient& P)
          std::string result = "";
          for (auto const& s : v_list) 
             result += s + "\u001f";
-         result.pop_back();
+         if (!result.empty())
+            result.pop_back();
          variant_lists.push_back(result);   
       }
       std::vector<char> variants = geno->variantsAsVector();
@@ -0,0 +1,47 @@
+#ifndef BEDREADER_H
+#define BEDREADER_H
+
+#include "GenomicRegion.h"
+#include "StringFunctions.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+using namespace cge::patients;
+
+namespace cge{
+   namespace dataaquisition{
+
+//Reads the intervals of a BED file. BED intervals are 0-based and half-open,
+//they are returned as 1-based, inclusive GenomicRegions. Chromosomes may be
+//written with or without a "chr" prefix; chromosomes that are not numbered
+//(chrX, chrM, chr6_apd_hap1, ...) cannot hold a GenomicLocation and are 
+//skipped.
+std::vector<GenomicRegion> readBEDRegions(std::istream& bed_file)
+{
+   std::vector<GenomicRegion> regions;
+   std::vector<utility::StringRef> cols;
+   std::string line;
+   while (std::getline(bed_file, line)){
+      if (line.empty() || line[0] == '#' || line.compare(0, 5, "track") == 0
+            || line.compare(0, 7, "browser") == 0)
+         continue;
+      if (utility::split(utility::StringRef(line), '\t', cols) < 3)
+         throw std::invalid_argument("Malformed BED line: " + line);
+      utility::StringRef chrom = cols[0];
+      if (chrom.size > 3 && std::memcmp(chrom.data, "chr", 3) == 0)
+         chrom = utility::StringRef(chrom.data + 3, chrom.size - 3);
+      if (chrom.empty() || std::find_if(chrom.begin(), chrom.end(), 
+            [](char c){return c < '0' || c > '9';}) != chrom.end())
+         continue;
+      regions.push_back(GenomicRegion((int)utility::toInteger(chrom),
+            (int)utility::toInteger(cols[1]) + 1, 
+            (int)utility::toInteger(cols[2])));
+   }
+   return regions;
+}
+
+}//dataaquisition
+}//cge
+#endif
@@ -0,0 +1,147 @@
+#ifndef BGZFREADER_H
+#define BGZFREADER_H
+
+#include <iostream>
+#include <streambuf>
+#include <stdexcept>
+#include <vector>
+#include <cstdint>
+#include <zlib.h>
+
+namespace cge{
+   namespace dataaquisition{
+
+//Decompresses a BGZF file (blocked gzip, as written by bgzip) one block at a
+//time. Wrap it in a std::istream to read the uncompressed text. Positions
+//are BGZF virtual offsets: the file offset of a block shifted left 16 bits,
+//or'd with the offset inside the uncompressed block.
+class BGZFStreamBuf : public std::streambuf
+{
+private:
+   std::istream& source;
+   std::vector<char> compressed;
+   std::vector<char> block;
+   uint64_t block_address;
+   uint64_t next_block_address;
+   z_stream inflater;
+   BGZFStreamBuf(const BGZFStreamBuf&);              //Prevent copy-construction
+   BGZFStreamBuf& operator=(const BGZFStreamBuf&);   //Prevent assignment
+
+   static uint32_t littleEndian(const unsigned char* p, int bytes)
+   {
+      uint32_t v = 0;
+      for (int i = bytes - 1; i >= 0; --i)
+         v = (v << 8) | p[i];
+      return v;
+   }
+
+   //Reads and inflates the block starting at next_block_address. Returns
+   //false at the end of the file.
+   bool readBlock()
+   {
+      unsigned char header[12];
+      source.read((char*)header, 12);
+      if (source.gcount() == 0)
+         return false;
+      if (source.gcount() != 12 || header[0] != 31 || header[1] != 139 ||
+            header[2] != 8 || (header[3] & 4) == 0)
+         throw std::runtime_error("Malformed BGZF block header");
+      //finds the BC subfield holding the block size
+      std::vector<unsigned char> extra(littleEndian(header + 10, 2));
+      source.read((char*)extra.data(), extra.size());
+      size_t block_size = 0;
+      for (size_t i = 0; i + 4 <= extra.size();
+            i += 4 + littleEndian(&extra[i + 2], 2)){
+         if (extra[i] == 'B' && extra[i + 1] == 'C' && i + 6 <= extra.size())
+            block_size = littleEndian(&extra[i + 4], 2) + 1;
+      }
+      if (block_size < 12 + extra.size() + 8)
+         throw std::runtime_error("Malformed BGZF block size");
+      size_t rest = block_size - 12 - extra.size();
+      compressed.resize(rest);
+      source.read(compressed.data(), rest);
+      if ((size_t)source.gcount() != rest)
+         throw std::runtime_error("Truncated BGZF block");
+      const unsigned char* footer =
+         (const unsigned char*)compressed.data() + rest - 8;
+      uint32_t crc = littleEndian(footer, 4);
+      uint32_t size = littleEndian(footer + 4, 4);
+      //inflates the raw deflate data
+      block.resize(size);
+      inflateReset(&inflater);
+      inflater.next_in = (Bytef*)compressed.data();
+      inflater.avail_in = rest - 8;
+      inflater.next_out = (Bytef*)block.data();
+      inflater.avail_out = size;
+      if (inflate(&inflater, Z_FINISH) != Z_STREAM_END ||
+            inflater.avail_out != 0)
+         throw std::runtime_error("Could not inflate BGZF block");
+      if (crc32(crc32(0L, Z_NULL, 0), (const Bytef*)block.data(), size) != crc)
+         throw std::runtime_error("BGZF block failed its CRC check");
+      block_address = next_block_address;
+      next_block_address += block_size;
+      setg(block.data(), block.data(), block.data() + size);
+      return true;
+   }
+protected:
+   int_type underflow()
+   {
+      //skips empty blocks such as the end of file marker
+      while (gptr() == egptr()){
+         if (!readBlock())
+            return traits_type::eof();
+      }
+      return traits_type::to_int_type(*gptr());
+   }
+public:
+   //compressed_input must be opened in binary mode and positioned at the
+   //start of the file.
+   BGZFStreamBuf(std::istream& compressed_input) :
+      source(compressed_input), block_address(0), next_block_address(0)
+   {
+      inflater.zalloc = Z_NULL;
+      inflater.zfree = Z_NULL;
+      inflater.opaque = Z_NULL;
+      inflater.next_in = Z_NULL;
+      inflater.avail_in = 0;
+      if (inflateInit2(&inflater, -15) != Z_OK)
+         throw std::runtime_error("Could not initialize zlib");
+      setg(nullptr, nullptr, nullptr);
+   }
+   ~BGZFStreamBuf()
+   {
+      inflateEnd(&inflater);
+   }
+
+   //Virtual offset of the next character to be read.
+   uint64_t virtualOffset() const
+   {
+      if (gptr() == egptr())
+         return next_block_address << 16;
+      return (block_address << 16) | (uint64_t)(gptr() - eback());
+   }
+
+   void seekVirtual(uint64_t offset)
+   {
+      uint64_t address = offset >> 16;
+      size_t within = offset & 0xFFFF;
+      if (eback() == nullptr || address != block_address){
+         source.clear();
+         source.seekg(address);
+         next_block_address = address;
+         setg(nullptr, nullptr, nullptr);
+         if (!readBlock()){
+            if (within != 0)
+               throw std::out_of_range("BGZF offset is past the end of file");
+            return;
+         }
+      }
+      if (within > block.size())
+         throw std::out_of_range("BGZF offset is past the end of its block");
+      setg(block.data(), block.data() + within, block.data() + block.size());
+   }
+};
+
+}//dataaquisition
+}//cge
+#endif
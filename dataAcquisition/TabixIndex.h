@@ -0,0 +1,224 @@
+#ifndef TABIXINDEX_H
+#define TABIXINDEX_H
+
+#include "BGZFReader.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+namespace cge{
+   namespace dataaquisition{
+
+//A tabix (.tbi) or coordinate-sorted (.csi) index over a BGZF compressed,
+//position sorted text file. Both are binning indexes; .tbi is the special
+//case with 14 bit leaf bins and 5 levels.
+class TabixIndex
+{
+public:
+   //A run of the compressed file, as BGZF virtual offsets [begin, end).
+   struct Chunk
+   {
+      uint64_t begin;
+      uint64_t end;
+   };
+private:
+   struct Bin
+   {
+      uint64_t min_offset; //.csi only
+      std::vector<Chunk> chunks;
+   };
+   struct Reference
+   {
+      std::unordered_map<uint32_t, Bin> bins;
+      std::vector<uint64_t> linear_index; //.tbi only
+   };
+
+   bool is_csi;
+   int min_shift;
+   int depth;
+   int32_t col_seq;
+   int32_t col_beg;
+   int32_t col_end;
+   char meta_char;
+   int32_t skip_lines;
+   std::vector<std::string> seq_names;
+   std::unordered_map<std::string, size_t> seq_ids;
+   std::vector<Reference> references;
+
+   static int32_t readInt32(std::istream& in)
+   {
+      unsigned char b[4];
+      in.read((char*)b, 4);
+      if (in.gcount() != 4)
+         throw std::runtime_error("Truncated index file");
+      return (int32_t)((uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+            ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24));
+   }
+   static uint64_t readUInt64(std::istream& in)
+   {
+      uint64_t low = (uint32_t)readInt32(in);
+      uint64_t high = (uint32_t)readInt32(in);
+      return low | (high << 32);
+   }
+
+   //Reads the tabix header fields shared by .tbi and the .csi aux block.
+   void readTabixHeader(std::istream& in)
+   {
+      readInt32(in); //format
+      col_seq = readInt32(in);
+      col_beg = readInt32(in);
+      col_end = readInt32(in);
+      meta_char = (char)readInt32(in);
+      skip_lines = readInt32(in);
+      std::string names(readInt32(in), '\0');
+      in.read(&names[0], names.size());
+      size_t start = 0;
+      for (size_t i = 0; i < names.size(); ++i){
+         if (names[i] == '\0'){
+            seq_ids[names.substr(start, i - start)] = seq_names.size();
+            seq_names.push_back(names.substr(start, i - start));
+            start = i + 1;
+         }
+      }
+   }
+
+   //Every bin that may hold features overlapping [beg, end).
+   void regionToBins(int64_t beg, int64_t end, std::vector<uint32_t>& bins) const
+   {
+      bins.clear();
+      int s = min_shift + depth * 3;
+      if (end > ((int64_t)1 << s))
+         end = (int64_t)1 << s;
+      if (beg >= end)
+         return;
+      --end;
+      for (int l = 0, t = 0; l <= depth; s -= 3, t += 1 << (l * 3), ++l){
+         for (int64_t b = t + (beg >> s); b <= t + (end >> s); ++b)
+            bins.push_back((uint32_t)b);
+      }
+   }
+
+   //Smallest virtual offset any feature starting at or after beg can have.
+   uint64_t minimumOffset(const Reference& ref, int64_t beg) const
+   {
+      if (!is_csi){
+         size_t i = beg >> min_shift;
+         if (ref.linear_index.empty())
+            return 0;
+         return ref.linear_index.at(std::min(i, ref.linear_index.size() - 1));
+      }
+      //walks up from the leaf bin to the first bin present in the index
+      int64_t bin = ((1 << (depth * 3)) - 1) / 7 + (beg >> min_shift);
+      while (bin > 0){
+         auto it = ref.bins.find((uint32_t)bin);
+         if (it != ref.bins.end())
+            return it->second.min_offset;
+         bin = (bin - 1) >> 3;
+      }
+      auto it = ref.bins.find(0);
+      return (it == ref.bins.end()) ? 0 : it->second.min_offset;
+   }
+public:
+   //Loads the index at path. Throws std::runtime_error if it cannot be read.
+   TabixIndex(const std::string& path) :
+      is_csi(false), min_shift(14), depth(5)
+   {
+      std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+      if (!file)
+         throw std::runtime_error("Could not open " + path);
+      BGZFStreamBuf buffer(file);
+      std::istream in(&buffer);
+      in.exceptions(std::ios::badbit);
+      char magic[4];
+      in.read(magic, 4);
+      if (in.gcount() == 4 && std::equal(magic, magic + 4, "TBI\1")){
+         references.resize(readInt32(in));
+         readTabixHeader(in);
+      }
+      else if (in.gcount() == 4 && std::equal(magic, magic + 4, "CSI\1")){
+         is_csi = true;
+         min_shift = readInt32(in);
+         depth = readInt32(in);
+         int32_t aux_size = readInt32(in);
+         if (aux_size < 28)
+            throw std::runtime_error("CSI index has no sequence names: " + path);
+         readTabixHeader(in);
+         references.resize(readInt32(in));
+      }
+      else
+         throw std::runtime_error("Not a tabix or CSI index: " + path);
+      for (auto ref = references.begin(); ref != references.end(); ++ref){
+         int32_t n_bins = readInt32(in);
+         for (int32_t i = 0; i < n_bins; ++i){
+            uint32_t id = (uint32_t)readInt32(in);
+            Bin& bin = ref->bins[id];
+            bin.min_offset = is_csi ? readUInt64(in) : 0;
+            bin.chunks.resize(readInt32(in));
+            for (auto c = bin.chunks.begin(); c != bin.chunks.end(); ++c){
+               c->begin = readUInt64(in);
+               c->end = readUInt64(in);
+            }
+         }
+         if (!is_csi){
+            ref->linear_index.resize(readInt32(in));
+            for (auto l = ref->linear_index.begin();
+                  l != ref->linear_index.end(); ++l)
+               *l = readUInt64(in);
+         }
+      }
+   }
+
+   const std::vector<std::string>& sequenceNames() const {return seq_names;}
+   bool hasSequence(const std::string& name) const
+   {
+      return seq_ids.count(name) > 0;
+   }
+   char metaChar() const {return meta_char;}
+   int sequenceColumn() const {return col_seq;}
+   int beginColumn() const {return col_beg;}
+
+   //Sorted, non-overlapping chunks of the compressed file that hold every
+   //feature of sequence name overlapping the 0-based, half-open interval
+   //[beg, end).
+   std::vector<Chunk> query(const std::string& name, int64_t beg,
+         int64_t end) const
+   {
+      std::vector<Chunk> result;
+      auto id = seq_ids.find(name);
+      if (id == seq_ids.end())
+         return result;
+      const Reference& ref = references.at(id->second);
+      uint64_t min_offset = minimumOffset(ref, std::max<int64_t>(beg, 0));
+      std::vector<uint32_t> bins;
+      regionToBins(std::max<int64_t>(beg, 0), end, bins);
+      for (auto b = bins.begin(); b != bins.end(); ++b){
+         auto bin = ref.bins.find(*b);
+         if (bin == ref.bins.end())
+            continue;
+         for (auto c = bin->second.chunks.begin();
+               c != bin->second.chunks.end(); ++c){
+            if (c->end > min_offset)
+               result.push_back(*c);
+         }
+      }
+      std::sort(result.begin(), result.end(),
+         [](const Chunk& a, const Chunk& b) {return a.begin < b.begin;});
+      //merges overlapping chunks
+      std::vector<Chunk> merged;
+      for (auto c = result.begin(); c != result.end(); ++c){
+         if (!merged.empty() && c->begin <= merged.back().end)
+            merged.back().end = std::max(merged.back().end, c->end);
+         else
+            merged.push_back(*c);
+      }
+      if (!merged.empty() && merged.front().begin < min_offset)
+         merged.front().begin = min_offset;
+      return merged;
+   }
+};
+
+}//dataaquisition
+}//cge
+#endif
@@ -1,77 +1,660 @@
 #ifndef VCFREADER_H
-#define VECREADER_H
+#define VCFREADER_H
 
-#include "Genotype.h"
+#include "PatientSet.h"
 #include "StringFunctions.h"
+#include "MappedFile.h"
+#include "BGZFReader.h"
+#include "TabixIndex.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <exception>
+#include <limits>
+#include <unordered_map>
 
 using namespace cge::patients;
 
 namespace cge{
    namespace dataaquisition{
 
-std::shared_ptr<GenotypeSchema> readVCFtoGenotype(std::istream& input_stream)
+//A single data line of a VCF file. For every sample column, sample_alleles
+//holds the pair of indices into alleles (ref first, then alts) that were
+//called; -1 marks a missing allele.
+struct VCFRecord
 {
-   std::vector<GenomicLocation> location_list;
-   std::vector<std::vector<std::string>> variant_list_list;
+   GenomicLocation location;
+   std::vector<std::string> alleles;
+   std::vector<std::pair<int,int>> sample_alleles;
+};
+
+//Common parsing for the VCF readers. Subclasses supply the data lines, 
+//tokenizing happens in place over views of each line so the only storage 
+//written per record is that of the VCFRecord being filled.
+class VCFRecordSource
+{
+private:
+   std::vector<utility::StringRef> fields;
+   //(sample index, slot in sample_alleles) of the selected samples, sorted
+   //by sample index
+   std::vector<std::pair<size_t,size_t>> selected_columns;
+   std::vector<std::string> selected_names;
+   bool has_selection;
+
+   static int parseAllele(utility::StringRef s)
+   {
+      if (s.empty() || s.equals("."))
+         return -1;
+      return (int)utility::toInteger(s);
+   }
+
+   static std::pair<int,int> parseGenotype(const char* b, const char* e)
+   {
+      e = std::find(b, e, ':');
+      const char* sep = b;
+      while (sep != e && *sep != '|' && *sep != '/')
+         ++sep;
+      int gt_1 = parseAllele(utility::StringRef(b, sep));
+      int gt_2 = -1;
+      if (sep != e)
+         gt_2 = parseAllele(utility::StringRef(sep + 1, e));
+      return std::make_pair(gt_1, gt_2);
+   }
+protected:
+   std::vector<std::string> sample_names;
+   static const int start_column = 9;
+
+   VCFRecordSource() : has_selection(false) { }
+
+   //Returns true if line is a data line. Header lines are consumed, the
+   //#CHROM line supplies the sample names.
+   bool isDataLine(utility::StringRef line)
+   {
+      if (line.empty())
+         return false;
+      if (line[0] != '#')
+         return true;
+      if (line.size >= 6 && std::memcmp(line.data, "#CHROM", 6) == 0){
+         std::vector<std::string> head = utility::split(line.str(), '\t');
+         if (head.size() > start_column)
+            sample_names.assign(head.begin() + start_column, head.end());
+      }
+      return false;
+   }
+
+   void parseRecord(utility::StringRef line, VCFRecord& rec)
+   {
+      //tokenizes the fixed columns, sample columns are walked below
+      fields.clear();
+      const char* p = line.begin();
+      const char* line_end = line.end();
+      while (fields.size() < start_column && p != line_end){
+         const char* tab = static_cast<const char*>
+            (std::memchr(p, '\t', line_end - p));
+         if (tab == nullptr)
+            tab = line_end;
+         fields.push_back(utility::StringRef(p, tab));
+         p = (tab == line_end) ? line_end : tab + 1;
+      }
+      if (fields.size() < 5)
+         throw std::invalid_argument("Malformed VCF record: " + line.str());
+      //records location, "chr2" and "2" name the same chromosome
+      utility::StringRef chrom = fields[0];
+      if (chrom.size > 3 && std::memcmp(chrom.data, "chr", 3) == 0)
+         chrom = utility::StringRef(chrom.data + 3, chrom.size - 3);
+      rec.location = GenomicLocation((int)utility::toInteger(chrom), 
+            utility::toInteger(fields[1]));
+      rec.location.setRSNumber(fields[2].str());
+      //records alleles, reusing the strings already in rec
+      size_t n_alleles = 2 + std::count(fields[4].begin(), fields[4].end(), ',');
+      rec.alleles.resize(n_alleles);
+      rec.alleles[0].assign(fields[3].data, fields[3].size);
+      const char* a = fields[4].begin();
+      for (size_t i = 1; i < n_alleles; ++i){
+         const char* comma = std::find(a, fields[4].end(), ',');
+         rec.alleles[i].assign(a, comma);
+         a = comma + 1;
+      }
+      //records variants(indicies), unselected columns are only skipped over
+      //and nothing past the last selected column is read
+      rec.sample_alleles.clear();
+      if (has_selection)
+         rec.sample_alleles.resize(selected_columns.size(), 
+               std::make_pair(-1, -1));
+      auto next = selected_columns.begin();
+      for (size_t col = 0; p != line_end; ++col){
+         if (has_selection && next == selected_columns.end())
+            break;
+         const char* tab = static_cast<const char*>
+            (std::memchr(p, '\t', line_end - p));
+         if (tab == nullptr)
+            tab = line_end;
+         if (!has_selection)
+            rec.sample_alleles.push_back(parseGenotype(p, tab));
+         else if (next->first == col){
+            std::pair<int,int> gt = parseGenotype(p, tab);
+            for (; next != selected_columns.end() && next->first == col; ++next)
+               rec.sample_alleles[next->second] = gt;
+         }
+         p = (tab == line_end) ? line_end : tab + 1;
+      }
+   }
+public:
+   virtual ~VCFRecordSource() { }
+
+   //Names of the samples whose genotypes are returned, in the order they
+   //appear in VCFRecord::sample_alleles.
+   const std::vector<std::string>& sampleNames() const
+   {
+      return has_selection ? selected_names : sample_names;
+   }
+
+   //Restricts parsing to the sample columns at indices (0 is the first
+   //sample column). Genotypes are returned in the order of indices, columns
+   //missing from a line are returned as missing calls.
+   void selectSampleColumns(const std::vector<size_t>& indices)
+   {
+      selected_columns.clear();
+      selected_names.clear();
+      for (size_t i = 0; i < indices.size(); ++i){
+         selected_columns.push_back(std::make_pair(indices[i], i));
+         selected_names.push_back((indices[i] < sample_names.size()) ?
+               sample_names[indices[i]] : "");
+      }
+      std::sort(selected_columns.begin(), selected_columns.end());
+      has_selection = true;
+   }
+
+   //Restricts parsing to the named samples, resolved against the #CHROM
+   //header line. Throws std::invalid_argument for an unknown sample.
+   void selectSamples(const std::vector<std::string>& names)
+   {
+      selectSampleColumns(sampleIndices(names));
+   }
+
+   void clearSampleSelection()
+   {
+      selected_columns.clear();
+      selected_names.clear();
+      has_selection = false;
+   }
+
+   //Positions of names among the sample columns of the #CHROM header line.
+   std::vector<size_t> sampleIndices(const std::vector<std::string>& names) const
+   {
+      std::unordered_map<std::string, size_t> positions;
+      for (size_t i = 0; i < sample_names.size(); ++i)
+         positions.insert(std::make_pair(sample_names[i], i));
+      std::vector<size_t> indices;
+      for (auto it = names.begin(); it != names.end(); ++it){
+         auto found = positions.find(*it);
+         if (found == positions.end())
+            throw std::invalid_argument("No such sample: " + *it);
+         indices.push_back(found->second);
+      }
+      return indices;
+   }
+
+   //Parses the next data line into rec. Returns false once the input is
+   //exhausted.
+   virtual bool nextRecord(VCFRecord& rec) = 0;
+
+   //Fills chunk with up to max_records records, reusing the storage of the
+   //records already in it. Returns the number of records read.
+   size_t nextChunk(std::vector<VCFRecord>& chunk, size_t max_records)
+   {
+      if (chunk.size() < max_records)
+         chunk.resize(max_records);
+      size_t n = 0;
+      while (n < max_records && nextRecord(chunk[n]))
+         ++n;
+      chunk.resize(n);
+      return n;
+   }
+};
+
+//Reads a VCF file one record at a time so that callers never have to hold
+//more than a bounded number of records in memory.
+class VCFStreamReader : public VCFRecordSource
+{
+private:
+   std::istream& input_stream;
+   std::string line;
+   bool has_pending_line;
+
+   bool readDataLine()
+   {
+      while(input_stream.good()){
+         std::getline(input_stream, line);
+         if (isDataLine(line))
+            return true;
+      }
+      return false;
+   }
+public:
+   VCFStreamReader(std::istream& input) : 
+      input_stream(input)
+   {
+      //reads the header so sample names are known before the first record
+      has_pending_line = readDataLine();
+   }
+
+   bool nextRecord(VCFRecord& rec)
+   {
+      if (!has_pending_line)
+         return false;
+      parseRecord(line, rec);
+      has_pending_line = readDataLine();
+      return true;
+   }
+};
+
+//Reads the VCF lines held in the character range [begin, end). The range 
+//is not copied, each line is tokenized in place.
+class VCFRangeReader : public VCFRecordSource
+{
+private:
+   const char* cursor;
+   const char* range_end;
+   utility::StringRef line;
+   bool has_pending_line;
+
+   bool readDataLine()
+   {
+      while (cursor != range_end){
+         const char* eol = static_cast<const char*>
+            (std::memchr(cursor, '\n', range_end - cursor));
+         if (eol == nullptr)
+            eol = range_end;
+         line = utility::StringRef(cursor, eol);
+         cursor = (eol == range_end) ? eol : eol + 1;
+         if (isDataLine(line))
+            return true;
+      }
+      return false;
+   }
+protected:
+   VCFRangeReader() : 
+      cursor(nullptr), range_end(nullptr), has_pending_line(false)
+   { }
+
+   void setRange(const char* begin, const char* end)
+   {
+      cursor = begin;
+      range_end = end;
+      has_pending_line = readDataLine();
+   }
+public:
+   VCFRangeReader(const char* begin, const char* end)
+   {
+      setRange(begin, end);
+   }
+
+   bool nextRecord(VCFRecord& rec)
+   {
+      if (!has_pending_line)
+         return false;
+      parseRecord(line, rec);
+      has_pending_line = readDataLine();
+      return true;
+   }
+};
+
+//Reads a VCF file through a read-only memory mapping. Lines are never 
+//copied, each one is tokenized directly out of the mapped pages.
+class VCFMappedReader : public VCFRangeReader
+{
+private:
+   utility::MappedFile mapped_file;
+public:
+   VCFMappedReader(const std::string& path) : 
+      mapped_file(path)
+   {
+      setRange(mapped_file.begin(), mapped_file.end());
+   }
+};
+
+//Reads the records of a BGZF compressed VCF file that overlap one region,
+//using the file's .tbi or .csi index to decompress only the blocks that can
+//hold them. region is "name", "name:beg" or "name:beg-end" with 1-based,
+//inclusive positions, e.g. "chr2:100000-200000".
+class VCFRegionReader : public VCFRecordSource
+{
+private:
+   std::ifstream file;
+   BGZFStreamBuf buffer;
+   std::istream input;
+   TabixIndex index;
+   std::string seq_name;
+   int64_t region_beg;
+   int64_t region_end;
+   std::vector<TabixIndex::Chunk> chunks;
+   size_t chunk_pos;
    std::string line;
-   const int start_column = 9;
-   
-   while(input_stream.good()){
-      std::getline(input_stream, line);
-      line.shrink_to_fit();
-      if (line.compare("") == 0 || line[0] == '#') //header
-         continue;
-      //setting SNP info
-      else{
-         std::vector<std::string> rec = utility::split(line, '\t');
-         //records location
-         GenomicLocation loc = 
-            GenomicLocation(std::stoi(rec[0]), std::stoi(rec[1]));
-         loc.setRSNumber(rec[2]);
-         location_list.push_back(loc);
-         
-         //records variants(indicies)
-         std::vector<std::string> variant_list;
-         std::vector<std::string> alleles;
-         alleles.push_back(rec[3]);
-         std::vector<std::string> alt_alleles = utility::split(rec[4], ',');
-         for (auto it = alt_alleles.begin(); it != alt_alleles.end(); ++it)
-            alleles.push_back(*it);
-         for(size_t i = start_column; i < rec.size(); ++i){
-            std::string gt_data = (utility::split(rec[i], ':'))[0];
-            int gt_1 = std::stoi((utility::split(gt_data,'|'))[0]);
-            int gt_2 = std::stoi((utility::split(gt_data,'|'))[1]);
-            variant_list.push_back(alleles[gt_1] + "|" + alleles[gt_2]);
+   bool has_pending_line;
+
+   static TabixIndex openIndex(const std::string& path)
+   {
+      if (std::ifstream((path + ".tbi").c_str()))
+         return TabixIndex(path + ".tbi");
+      return TabixIndex(path + ".csi");
+   }
+
+   void parseRegion(const std::string& region)
+   {
+      size_t colon = region.rfind(':');
+      seq_name = region.substr(0, colon);
+      region_beg = 0;
+      region_end = std::numeric_limits<int32_t>::max();
+      if (colon != std::string::npos){
+         std::string range = region.substr(colon + 1);
+         range.erase(std::remove(range.begin(), range.end(), ','), range.end());
+         size_t dash = range.find('-');
+         region_beg = utility::toInteger(range.substr(0, dash)) - 1;
+         if (dash != std::string::npos && dash + 1 < range.size())
+            region_end = utility::toInteger(range.substr(dash + 1));
+         if (region_beg < 0 || region_end <= region_beg)
+            throw std::invalid_argument("Invalid region: " + region);
+      }
+      //files disagree on whether chromosomes carry a "chr" prefix
+      if (!index.hasSequence(seq_name)){
+         if (seq_name.compare(0, 3, "chr") == 0 && 
+               index.hasSequence(seq_name.substr(3)))
+            seq_name = seq_name.substr(3);
+         else if (index.hasSequence("chr" + seq_name))
+            seq_name = "chr" + seq_name;
+      }
+   }
+
+   bool readDataLine()
+   {
+      std::vector<utility::StringRef> cols;
+      while (chunk_pos < chunks.size()){
+         if (buffer.virtualOffset() >= chunks[chunk_pos].end){
+            if (++chunk_pos < chunks.size() && 
+                  buffer.virtualOffset() < chunks[chunk_pos].begin)
+               buffer.seekVirtual(chunks[chunk_pos].begin);
+            continue;
          }
-         variant_list_list.push_back(variant_list);
+         if (!std::getline(input, line))
+            return false;
+         if (!isDataLine(line))
+            continue;
+         if (utility::split(utility::StringRef(line), '\t', cols) < 4)
+            throw std::invalid_argument("Malformed VCF record: " + line);
+         if (cols[0].size != seq_name.size() || 
+               std::memcmp(cols[0].data, seq_name.data(), cols[0].size) != 0)
+            continue;
+         //records are sorted, so nothing after one past the region matches
+         int64_t beg = utility::toInteger(cols[1]) - 1;
+         if (beg >= region_end)
+            return false;
+         if (beg + (int64_t)std::max<size_t>(cols[3].size, 1) > region_beg)
+            return true;
       }
+      return false;
+   }
+public:
+   VCFRegionReader(const std::string& path, const std::string& region) : 
+      file(path.c_str(), std::ios::in | std::ios::binary), buffer(file),
+      input(&buffer), index(openIndex(path)), chunk_pos(0)
+   {
+      if (!file)
+         throw std::runtime_error("Could not open " + path);
+      input.exceptions(std::ios::badbit);
+      parseRegion(region);
+      //reads the header so sample names are known before the first record
+      while (std::getline(input, line) && !isDataLine(line));
+      chunks = index.query(seq_name, region_beg, region_end);
+      if (!chunks.empty())
+         buffer.seekVirtual(chunks[0].begin);
+      has_pending_line = readDataLine();
+   }
+
+   bool nextRecord(VCFRecord& rec)
+   {
+      if (!has_pending_line)
+         return false;
+      parseRecord(line, rec);
+      has_pending_line = readDataLine();
+      return true;
+   }
+};
+
+typedef std::function<bool(const std::vector<VCFRecord>&)> VCFChunkHandler;
+
+//Streams the records of reader through handler in chunks of at most 
+//chunk_size records. handler may return false to stop reading early. Returns
+//the number of records handed to handler.
+size_t readVCFChunks(VCFRecordSource& reader, size_t chunk_size,
+      VCFChunkHandler handler)
+{
+   if (chunk_size == 0)
+      throw std::invalid_argument("Chunk size must be positive");
+   std::vector<VCFRecord> chunk;
+   size_t total = 0;
+   while (reader.nextChunk(chunk, chunk_size) > 0){
+      total += chunk.size();
+      if (!handler(chunk))
+         break;
+   }
+   return total;
+}
+
+size_t readVCFChunks(std::istream& input_stream, size_t chunk_size,
+      VCFChunkHandler handler)
+{
+   VCFStreamReader reader(input_stream);
+   return readVCFChunks(reader, chunk_size, handler);
+}
+
+//Builds the VariantField describing rec. The site's alleles are stored once
+//and each sample's call as a GenotypeCode.
+VariantField* variantFieldFromRecord(const VCFRecord& rec)
+{
+   std::string field_name;
+   const std::string rs = rec.location.rsNumber();
+   if (rs.compare("rs") == 0 || rs.compare("") == 0 || rs.compare(".") == 0)
+      field_name = std::to_string(rec.location.chromosome()) 
+         + "." + std::to_string(rec.location.position());
+   else
+      field_name = rs;
+   const int n_alleles = (int)rec.alleles.size();
+   std::vector<GenotypeCode> codes;
+   codes.reserve(rec.sample_alleles.size());
+   for (auto it = rec.sample_alleles.begin(); 
+         it != rec.sample_alleles.end(); ++it){
+      if (it->first >= n_alleles || it->second >= n_alleles)
+         throw std::out_of_range("Genotype refers to a missing allele");
+      codes.push_back(VariantField::encodeGenotype(it->first, it->second));
    }
-   //returns schema
+   VariantField* f = new VariantField();
+   f->setName(field_name);
+   f->setLocation(rec.location);
+   f->setAlleles(rec.alleles);
+   f->setSampleGenotypes(codes);
+   return f;
+}
+
+//Appends batch to geno in one pass. If the batch is rejected its fields are
+//deleted before the exception is passed on.
+void appendFieldBatch(GenotypeSchema& geno, const std::vector<VariantField*>& batch)
+{
+   try{
+      geno.appendFields(batch);
+   }
+   catch(...){
+      for (auto it = batch.begin(); it != batch.end(); ++it)
+         delete *it;
+      throw;
+   }
+}
+
+std::shared_ptr<GenotypeSchema> readVCFtoGenotype(VCFRecordSource& reader,
+      size_t chunk_size = 4096)
+{
    std::shared_ptr<GenotypeSchema> geno(new GenotypeSchema());
-   for(size_t i = 0; i < location_list.size(); ++i){
-      std::string field_name;
-      if ((location_list[i].rsNumber().compare("rs") == 0)
-            || (location_list[i].rsNumber().compare("") == 0))
-         field_name = std::to_string(location_list[i].chromosome()) 
-            + "." + std::to_string(location_list[i].position());
-      VariantField* f = new VariantField();
-      f->setName(field_name);
-      f->setLocation(location_list[i]);
-      f->setVariantList(variant_list_list[i]);
-      geno->appendField(f);
+   std::vector<VariantField*> batch;
+   readVCFChunks(reader, chunk_size, 
+      [&geno, &batch](const std::vector<VCFRecord>& chunk)
+      {
+         batch.clear();
+         for (auto it = chunk.begin(); it != chunk.end(); ++it)
+            batch.push_back(variantFieldFromRecord(*it));
+         appendFieldBatch(*geno, batch);
+         return true;
+      });
+   return geno;
+}
+
+std::shared_ptr<GenotypeSchema> readVCFtoGenotype(std::istream& input_stream,
+      size_t chunk_size = 4096)
+{
+   VCFStreamReader reader(input_stream);
+   return readVCFtoGenotype(reader, chunk_size);
+}
+
+//Reads only the genotypes of the named samples. Columns of other samples
+//are skipped without being decoded.
+std::shared_ptr<GenotypeSchema> readVCFtoGenotype(std::istream& input_stream,
+      const std::vector<std::string>& samples, size_t chunk_size = 4096)
+{
+   VCFStreamReader reader(input_stream);
+   reader.selectSamples(samples);
+   return readVCFtoGenotype(reader, chunk_size);
+}
+
+//Same as readVCFtoGenotype, but memory maps the file at path instead of
+//reading it through a stream.
+std::shared_ptr<GenotypeSchema> readMappedVCFtoGenotype(const std::string& path,
+      size_t chunk_size = 4096)
+{
+   VCFMappedReader reader(path);
+   return readVCFtoGenotype(reader, chunk_size);
+}
+
+//Reads a whole BGZF compressed VCF file (.vcf.gz).
+std::shared_ptr<GenotypeSchema> readBGZFVCFtoGenotype(const std::string& path,
+      size_t chunk_size = 4096)
+{
+   std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+   if (!file)
+      throw std::runtime_error("Could not open " + path);
+   BGZFStreamBuf buffer(file);
+   std::istream input(&buffer);
+   input.exceptions(std::ios::badbit);
+   VCFStreamReader reader(input);
+   return readVCFtoGenotype(reader, chunk_size);
+}
+
+//Reads only the records of the indexed .vcf.gz file at path that overlap
+//region, see VCFRegionReader.
+std::shared_ptr<GenotypeSchema> readVCFRegiontoGenotype(const std::string& path,
+      const std::string& region, size_t chunk_size = 4096)
+{
+   VCFRegionReader reader(path, region);
+   return readVCFtoGenotype(reader, chunk_size);
+}
+
+//Reads the VCF file at path on n_threads worker threads. The mapped file is
+//cut into one byte range per thread, each range ending just after a newline,
+//and the ranges are parsed concurrently. Fields are appended to the schema 
+//in file order, so the result matches readVCFtoGenotype. n_threads = 0 uses
+//one thread per hardware core. If samples is not empty, only the genotypes
+//of those samples are decoded.
+std::shared_ptr<GenotypeSchema> readVCFtoGenotypeParallel(
+      const std::string& path, const std::vector<std::string>& samples, 
+      unsigned n_threads = 0, size_t chunk_size = 4096)
+{
+   if (n_threads == 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+   utility::MappedFile mapped_file(path);
+   //only the first range holds the header, so sample names are resolved 
+   //once up front
+   std::vector<size_t> sample_columns;
+   if (!samples.empty()){
+      VCFRangeReader header(mapped_file.begin(), mapped_file.end());
+      sample_columns = header.sampleIndices(samples);
+   }
+   //splits the file on line boundaries
+   std::vector<const char*> bounds(1, mapped_file.begin());
+   for (unsigned t = 1; t < n_threads; ++t){
+      const char* cut = mapped_file.begin() + 
+         (mapped_file.size() / n_threads) * t;
+      if (cut < bounds.back())
+         cut = bounds.back();
+      const char* eol = (cut == mapped_file.end()) ? nullptr :
+         static_cast<const char*>
+            (std::memchr(cut, '\n', mapped_file.end() - cut));
+      bounds.push_back(eol == nullptr ? mapped_file.end() : eol + 1);
+   }
+   bounds.push_back(mapped_file.end());
+   //parses each range
+   std::vector<std::vector<VariantField*>> parts(n_threads);
+   std::vector<std::exception_ptr> errors(n_threads);
+   std::vector<std::thread> workers;
+   for (unsigned t = 0; t < n_threads; ++t){
+      workers.push_back(std::thread([&, t]()
+      {
+         try{
+            VCFRangeReader reader(bounds[t], bounds[t + 1]);
+            if (!samples.empty())
+               reader.selectSampleColumns(sample_columns);
+            readVCFChunks(reader, chunk_size, 
+               [&parts, t](const std::vector<VCFRecord>& chunk)
+               {
+                  for (auto it = chunk.begin(); it != chunk.end(); ++it)
+                     parts[t].push_back(variantFieldFromRecord(*it));
+                  return true;
+               });
+         }
+         catch(...){
+            errors[t] = std::current_exception();
+         }
+      }));
    }
+   for (auto it = workers.begin(); it != workers.end(); ++it)
+      it->join();
+   for (unsigned t = 0; t < n_threads; ++t){
+      if (errors[t]){
+         for (auto p = parts.begin(); p != parts.end(); ++p)
+            for (auto f = p->begin(); f != p->end(); ++f)
+               delete *f;
+         std::rethrow_exception(errors[t]);
+      }
+   }
+   //merges the ranges in file order
+   std::vector<VariantField*> all_fields;
+   size_t n_fields = 0;
+   for (auto p = parts.begin(); p != parts.end(); ++p)
+      n_fields += p->size();
+   all_fields.reserve(n_fields);
+   for (auto p = parts.begin(); p != parts.end(); ++p)
+      all_fields.insert(all_fields.end(), p->begin(), p->end());
+   std::shared_ptr<GenotypeSchema> geno(new GenotypeSchema());
+   appendFieldBatch(*geno, all_fields);
    return geno;
+}
 
+std::shared_ptr<GenotypeSchema> readVCFtoGenotypeParallel(
+      const std::string& path, unsigned n_threads = 0, 
+      size_t chunk_size = 4096)
+{
+   return readVCFtoGenotypeParallel(path, std::vector<std::string>(), 
+         n_threads, chunk_size);
 }
+
 bool readVCF(std::istream &input, Patient& P)
 {
    try{
    std::shared_ptr<GenotypeSchema> fields = readVCFtoGenotype(input); 
-   for (auto it = fields->begin(); it != fields->end(); ++it)
-      P.genotype()->schema()->appendField(*it);
+   P.genotype()->schema()->appendFields(
+         std::vector<VariantField*>(fields->begin(), fields->end()));
    return true;
    }
    catch(...){
@@ -82,10 +665,9 @@ bool readVCF(std::istream & input, PatientSet& p_set)
 {
    try{
    std::shared_ptr<GenotypeSchema> fields = readVCFtoGenotype(input);
-   for (auto i = p_set.begin(); i != p_set.end(); ++i){
-      for (auto it = fields->begin(); it != fields->end(); ++it)
-         (*i)->genotype()->schema()->appendField(*it);
-   }
+   const std::vector<VariantField*> batch(fields->begin(), fields->end());
+   for (auto i = p_set.begin(); i != p_set.end(); ++i)
+      (*i)->genotype()->schema()->appendFields(batch);
    return true;   
    }
    catch(...){
@@ -0,0 +1,41 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace utility{
+
+MappedFile::MappedFile(const std::string& path) : 
+   file_data(nullptr), file_size(0)
+{
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd < 0)
+      throw std::runtime_error("Could not open " + path);
+   struct stat info;
+   if (fstat(fd, &info) != 0){
+      close(fd);
+      throw std::runtime_error("Could not stat " + path);
+   }
+   file_size = info.st_size;
+   //mmap rejects zero length mappings, an empty file simply has no data
+   if (file_size > 0){
+      void* mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED){
+         close(fd);
+         throw std::runtime_error("Could not map " + path);
+      }
+      madvise(mapped, file_size, MADV_SEQUENTIAL);
+      file_data = static_cast<const char*>(mapped);
+   }
+   close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+   if (file_data != nullptr)
+      munmap(const_cast<char*>(file_data), file_size);
+}
+
+}
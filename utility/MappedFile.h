@@ -0,0 +1,31 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+namespace utility{
+
+//Read-only memory mapping of a whole file. The mapping is released when the
+//MappedFile is destroyed.
+class MappedFile
+{
+private:
+   const char* file_data;
+   size_t file_size;
+   MappedFile(const MappedFile&);              //Prevent copy-construction
+   MappedFile& operator=(const MappedFile&);   //Prevent assignment
+public:
+   //Throws std::runtime_error if path cannot be opened or mapped.
+   MappedFile(const std::string& path);
+   ~MappedFile();
+
+   const char* data() const {return file_data;}
+   size_t size() const {return file_size;}
+   const char* begin() const {return file_data;}
+   const char* end() const {return file_data + file_size;}
+};
+
+}
+
+#endif
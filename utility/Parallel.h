@@ -0,0 +1,55 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+namespace utility{
+
+//Runs work(first, last) over [0, n) split into n_threads ranges (0 for one 
+//per core) whose bounds are multiples of align, the calling thread taking 
+//the first. The first exception thrown by any range is rethrown once all 
+//have finished.
+inline void parallelRanges(size_t n, unsigned n_threads, size_t align,
+      const std::function<void(size_t, size_t)>& work)
+{
+   if (n_threads == 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+   n_threads = (unsigned)std::min<size_t>(n_threads, 
+         std::max<size_t>(1, (n + align - 1) / align));
+   size_t per_thread = (n + n_threads - 1) / n_threads;
+   per_thread = (per_thread + align - 1) / align * align;
+   std::vector<std::exception_ptr> errors(n_threads);
+   std::vector<std::thread> workers;
+   for (unsigned t = 1; t < n_threads; ++t){
+      workers.push_back(std::thread([&, t]()
+      {
+         try{
+            size_t first = std::min(n, t * per_thread);
+            work(first, std::min(n, first + per_thread));
+         }
+         catch(...){
+            errors[t] = std::current_exception();
+         }
+      }));
+   }
+   try{
+      work(0, std::min(n, per_thread));
+   }
+   catch(...){
+      errors[0] = std::current_exception();
+   }
+   for (auto it = workers.begin(); it != workers.end(); ++it)
+      it->join();
+   for (auto e = errors.begin(); e != errors.end(); ++e){
+      if (*e)
+         std::rethrow_exception(*e);
+   }
+}
+
+}//namespace utility
+#endif
@@ -1,4 +1,5 @@
 #include "StringFunctions.h"
+#include <stdexcept>
 
 namespace utility{
 
@@ -13,5 +14,39 @@ std::vector<std::string> split(const std::string &s, char delim)
    return items;
 }
 
+size_t split(StringRef s, char delim, std::vector<StringRef>& items)
+{
+   items.clear();
+   const char* start = s.begin();
+   const char* stop = s.end();
+   while (start != stop){
+      const char* next = static_cast<const char*>
+         (std::memchr(start, delim, stop - start));
+      if (next == nullptr){
+         items.push_back(StringRef(start, stop));
+         break;
+      }
+      items.push_back(StringRef(start, next));
+      start = next + 1;
+   }
+   return items.size();
+}
+
+long long toInteger(StringRef s)
+{
+   size_t i = 0;
+   bool negative = false;
+   if (i < s.size && (s[i] == '-' || s[i] == '+')){
+      negative = (s[i] == '-');
+      ++i;
+   }
+   if (i >= s.size || s[i] < '0' || s[i] > '9')
+      throw std::invalid_argument("Not an integer: " + s.str());
+   long long value = 0;
+   for (; i < s.size && s[i] >= '0' && s[i] <= '9'; ++i)
+      value = value * 10 + (s[i] - '0');
+   return negative ? -value : value;
+}
+
 }
 
@@ -4,11 +4,43 @@
 #include <vector> 
 #include <string> 
 #include <sstream>
+#include <cstring>
 
 namespace utility{
 
+//A non-owning view of a run of characters. The characters must outlive the
+//StringRef.
+struct StringRef
+{
+   const char* data;
+   size_t size;
+
+   StringRef() : data(nullptr), size(0) { }
+   StringRef(const char* d, size_t n) : data(d), size(n) { }
+   StringRef(const char* b, const char* e) : data(b), size(e - b) { }
+   StringRef(const std::string& s) : data(s.data()), size(s.size()) { }
+
+   const char* begin() const {return data;}
+   const char* end() const {return data + size;}
+   bool empty() const {return size == 0;}
+   char operator[](size_t i) const {return data[i];}
+   std::string str() const {return std::string(data, size);}
+   bool equals(const char* s) const
+   {
+      return (std::strlen(s) == size) && (std::memcmp(data, s, size) == 0);
+   }
+};
+
 std::vector<std::string> split(const std::string &s, char delim);
 
+//Splits s on delim into views over s, reusing the storage of items. Returns
+//the number of items.
+size_t split(StringRef s, char delim, std::vector<StringRef>& items);
+
+//Parses a base 10 integer with an optional sign. Throws
+//std::invalid_argument if s does not begin with a digit.
+long long toInteger(StringRef s);
+
 }
 
 